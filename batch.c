@@ -0,0 +1,170 @@
+#include <pthread.h>
+#include <time.h>
+#include "batch.h"
+#include "search.h"
+
+#define BATCH_CHUNK 64
+
+
+typedef struct
+{
+    const unsigned long long* grids;
+    const unsigned long long* actions;
+    const unsigned* sizes;
+    const unsigned* heights;
+    unsigned long long* solutions;
+    int* statuses;
+    size_t count;
+    size_t next;
+    size_t solved;
+    int workers;
+    Latency* latency;
+    pthread_mutex_t lock;
+} SolveJob;
+
+/**
+ * @brief Solves the puzzle at one position of a batch.
+ *
+ * @return The status of the puzzle, the solution is written in place.
+ */
+static BatchStatus solveAt(const SolveJob* job, size_t i)
+{
+    unsigned size = job->sizes[i];
+    unsigned height = job->heights ? job->heights[i] : size;
+    Puzzle puzzle = {
+        .grid = job->grids[i],
+        .actions = job->actions[i],
+        .size = size,
+        .height = height == size ? 0 : height
+    };
+
+    job->solutions[i] = 0;
+    if (size < 4 || height < 4 || size % 2 || height % 2 || size * height > 64) { return BATCH_INVALID; }
+    if (!isValid(&puzzle)) { return BATCH_INVALID; }
+
+    Puzzle solution;
+    unsigned long long found = countSolutions(puzzle, 2, &solution);
+    if (!found) { return BATCH_NO_SOLUTION; }
+
+    job->solutions[i] = solution.grid;
+    return found == 1 ? BATCH_UNIQUE : BATCH_MULTIPLE;
+}
+
+/**
+ * @brief Solves the puzzle at one position of a batch and records how long
+ *        it took, see solveBatchTimed().
+ */
+static BatchStatus solveTimedAt(const SolveJob* job, size_t i, int worker)
+{
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    BatchStatus status = solveAt(job, i);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    unsigned long long nanoseconds = (end.tv_sec - begin.tv_sec) * 1000000000ULL + end.tv_nsec - begin.tv_nsec;
+    unsigned height = job->heights ? job->heights[i] : job->sizes[i];
+    recordLatency(job->latency, worker, job->sizes[i], height, status, nanoseconds);
+    return status;
+}
+
+static void* runSolveJob(void* argument)
+{
+    SolveJob* job = argument;
+    size_t solved = 0;
+
+    pthread_mutex_lock(&job->lock);
+    int worker = job->workers++;
+    pthread_mutex_unlock(&job->lock);
+
+    while (true)
+    {
+        pthread_mutex_lock(&job->lock);
+        size_t start = job->next;
+        job->next += BATCH_CHUNK;
+        if (start >= job->count) { job->solved += solved; }
+        pthread_mutex_unlock(&job->lock);
+        if (start >= job->count) { return NULL; }
+
+        for (size_t i = start; i < start + BATCH_CHUNK && i < job->count; i++)
+        {
+            job->statuses[i] = job->latency ? solveTimedAt(job, i, worker) : solveAt(job, i);
+            solved += job->statuses[i] <= BATCH_MULTIPLE;
+        }
+    }
+}
+
+/**
+ * @brief Solves many puzzles given as parallel arrays.
+ *
+ * Puzzle i is grids[i], actions[i] (1 for an empty cell, as in Puzzle) and
+ * sizes[i], with heights[i] rows for rectangular puzzles. Nothing is
+ * allocated per puzzle and all arrays are plain integers, so callers can
+ * pass their own buffers, e.g. numpy arrays of uint64, uint32 and int32
+ * through ctypes.
+ *
+ * The puzzles are handed out to the threads in chunks of BATCH_CHUNK, so
+ * slow puzzles do not hold up the others and small batches run on the
+ * calling thread only. The search branches too irregularly to run several
+ * puzzles in lockstep, so threads are the only source of parallelism.
+ *
+ * @param grids The filled in cells of each puzzle.
+ * @param actions The empty cells of each puzzle.
+ * @param sizes The width of each puzzle.
+ * @param heights The height of each puzzle, or NULL if all are square.
+ * @param solutions Receives the grid of a solution of each puzzle, 0 if
+ *                  there is none.
+ * @param statuses Receives the BatchStatus of each puzzle.
+ * @param count The number of puzzles.
+ * @param threads The number of threads to solve with, at most 64.
+ *
+ * @return The number of puzzles with at least one solution.
+ */
+size_t solveBatch(const unsigned long long grids[], const unsigned long long actions[], const unsigned sizes[], const unsigned heights[],
+    unsigned long long solutions[], int statuses[], size_t count, int threads)
+{
+    return solveBatchTimed(grids, actions, sizes, heights, solutions, statuses, count, threads, NULL);
+}
+
+/**
+ * @brief Solves many puzzles like solveBatch(), recording the latency of
+ *        each in histograms per size and BatchStatus.
+ *
+ * Each thread records into its own histograms, see latency.c, so timing
+ * adds two clock reads per puzzle and no contention. The same histograms
+ * can be passed to several calls one after another to accumulate, and read
+ * by another thread while a call is running.
+ *
+ * @param latency The histograms, or NULL to record nothing.
+ *
+ * @return The number of puzzles with at least one solution.
+ */
+size_t solveBatchTimed(const unsigned long long grids[], const unsigned long long actions[], const unsigned sizes[], const unsigned heights[],
+    unsigned long long solutions[], int statuses[], size_t count, int threads, Latency* latency)
+{
+    SolveJob job = {
+        .grids = grids,
+        .actions = actions,
+        .sizes = sizes,
+        .heights = heights,
+        .solutions = solutions,
+        .statuses = statuses,
+        .count = count,
+        .next = 0,
+        .solved = 0,
+        .workers = 0,
+        .latency = latency
+    };
+    pthread_t ids[64];
+
+    if (threads > 64) { threads = 64; }
+    if (threads > (count + BATCH_CHUNK - 1) / BATCH_CHUNK) { threads = (count + BATCH_CHUNK - 1) / BATCH_CHUNK; }
+    if (threads < 1) { threads = 1; }
+
+    pthread_mutex_init(&job.lock, NULL);
+    int started = 1;
+    while (started < threads && !pthread_create(&ids[started], NULL, runSolveJob, &job)) { started++; }
+    runSolveJob(&job);
+    for (int i = 1; i < started; i++) { pthread_join(ids[i], NULL); }
+    pthread_mutex_destroy(&job.lock);
+    return job.solved;
+}
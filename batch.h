@@ -0,0 +1,21 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include "takuzu.h"
+#include "latency.h"
+
+typedef enum
+{
+    BATCH_UNIQUE = 0,
+    BATCH_MULTIPLE = 1,
+    BATCH_NO_SOLUTION = 2,
+    BATCH_INVALID = 3
+} BatchStatus;
+
+size_t solveBatch(const unsigned long long grids[], const unsigned long long actions[], const unsigned sizes[], const unsigned heights[],
+    unsigned long long solutions[], int statuses[], size_t count, int threads);
+size_t solveBatchTimed(const unsigned long long grids[], const unsigned long long actions[], const unsigned sizes[], const unsigned heights[],
+    unsigned long long solutions[], int statuses[], size_t count, int threads, Latency* latency);
+
+#endif
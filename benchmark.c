@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "takuzu.h"
+#include "batch.h"
+#include "dispatch.h"
+#include "generate.h"
+
+
+static double getTime(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Reads the puzzles of a corpus into parallel arrays.
+ *
+ * Each line holds a puzzle string, optionally in quotes as printed by
+ * --generate; other lines are skipped.
+ *
+ * @return The number of puzzles read, at most max.
+ */
+static size_t readCorpus(FILE* input, unsigned long long grids[], unsigned long long actions[], unsigned sizes[], size_t max)
+{
+    char line[256];
+    size_t count = 0;
+    while (count < max && fgets(line, sizeof(line), input))
+    {
+        char* puzzleString = line + (line[0] == '\'');
+        size_t length = strspn(puzzleString, "01 ");
+        if (length != 16 && length != 36 && length != 64) { continue; }
+
+        puzzleString[length] = '\0';
+        Puzzle puzzle = getPuzzle(puzzleString);
+        grids[count] = puzzle.grid;
+        actions[count] = getEmpty(&puzzle);
+        sizes[count++] = puzzle.size;
+    }
+    return count;
+}
+
+/**
+ * @brief Benchmarks the solver and the grader on a corpus of puzzles.
+ *
+ * Usage: takuzu_bench [corpus] [rounds]
+ * Each round solves every puzzle with solveBatch() on one thread and grades
+ * every puzzle with gradePuzzle(). The best round is reported, so the
+ * result is stable enough to compare builds, e.g. with and without PGO, or
+ * kernel levels with --cpu.
+ */
+int main(int argc, char** argv)
+{
+    if (argc > 2 && !strcmp(argv[1], "--cpu"))
+    {
+        CpuLevel level;
+        if (!parseCpuLevel(argv[2], &level) || !forceCpuLevel(level))
+        {
+            printf("Error: Level %s is unknown or not supported.\n", argv[2]);
+            return EXIT_FAILURE;
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    if (argc != 2 && argc != 3)
+    {
+        printf("Error: Invalid number of arguments.\n");
+        printf("Usage: %s [--cpu level] [corpus] [rounds]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    enum { MAX_CORPUS = 1 << 16 };
+    static unsigned long long grids[MAX_CORPUS], actions[MAX_CORPUS], solutions[MAX_CORPUS];
+    static unsigned sizes[MAX_CORPUS];
+    static int statuses[MAX_CORPUS];
+
+    FILE* input = fopen(argv[1], "r");
+    if (!input)
+    {
+        printf("Error: Could not read %s.\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    size_t count = readCorpus(input, grids, actions, sizes, MAX_CORPUS);
+    fclose(input);
+
+    int rounds = argc == 3 ? atoi(argv[2]) : 5;
+    double best_solve = 0, best_grade = 0;
+    size_t solved = 0;
+    size_t graded = 0;
+    int grades = 0;
+
+    for (int round = 0; round < rounds; round++)
+    {
+        double start = getTime();
+        solved = solveBatch(grids, actions, sizes, NULL, solutions, statuses, count, 1);
+        double solve = getTime() - start;
+
+        start = getTime();
+        graded = 0;
+        grades = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (statuses[i] != BATCH_UNIQUE) { continue; }
+            Puzzle puzzle = { .grid = grids[i], .actions = actions[i], .size = sizes[i] };
+            grades += gradePuzzle(&puzzle);
+            graded++;
+        }
+        double grade = getTime() - start;
+
+        if (!round || solve < best_solve) { best_solve = solve; }
+        if (!round || grade < best_grade) { best_grade = grade; }
+    }
+
+    printf("Kernels: %s\n", getCpuLevelName(getCpuLevel()));
+    printf("Solved %zu of %zu puzzles in %.3f ms (%.0f puzzles per second).\n",
+        solved, count, best_solve * 1e3, best_solve > 0 ? count / best_solve : 0);
+    printf("Graded %zu puzzles in %.3f ms (grade sum %d).\n", graded, best_grade * 1e3, grades);
+    return EXIT_SUCCESS;
+}
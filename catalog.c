@@ -0,0 +1,296 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "catalog.h"
+#include "generate.h"
+#include "search.h"
+
+#define CATALOG_MAGIC 0x475A4B54U
+#define CATALOG_SIZES 3
+#define CATALOG_BUCKETS (CATALOG_SIZES * MAX_GRADE)
+
+
+/**
+ * A catalog file starts with a header holding the offset and length of one
+ * bucket per size and grade, followed by the buckets. A bucket is an array
+ * of fixed size records, so the puzzle at any position is found without
+ * decoding anything and the pages of a bucket are only touched when a
+ * puzzle in them is read.
+ */
+typedef struct
+{
+    unsigned long long offset;
+    unsigned long long count;
+} CatalogBucket;
+
+typedef struct
+{
+    unsigned magic;
+    unsigned grades;
+    CatalogBucket buckets[CATALOG_BUCKETS];
+} CatalogHeader;
+
+typedef struct
+{
+    unsigned long long grid;
+    unsigned long long actions;
+} CatalogRecord;
+
+struct CatalogWriter
+{
+    char path[4096];
+    FILE* buckets[CATALOG_BUCKETS];
+    unsigned long long counts[CATALOG_BUCKETS];
+};
+
+struct Catalog
+{
+    int fd;
+    size_t length;
+    const unsigned char* data;
+    const CatalogHeader* header;
+};
+
+/**
+ * @brief Maps a size and grade to the number of their bucket.
+ *
+ * @return The bucket, or -1 if there is none.
+ */
+static int getBucket(unsigned size, int grade)
+{
+    if (size < 4 || size > 8 || size % 2 || grade < 1 || grade > MAX_GRADE) { return -1; }
+    return (size/2 - 2) * MAX_GRADE + grade - 1;
+}
+
+static void getBucketPath(const CatalogWriter* writer, int bucket, char* path, size_t length)
+{
+    snprintf(path, length, "%s.bucket%d", writer->path, bucket);
+}
+
+/**
+ * @brief Starts writing a catalog of graded puzzles.
+ *
+ * Puzzles are appended to one temporary file per bucket, which are joined
+ * into the catalog by closeCatalogWriter(), so nothing is held in memory.
+ *
+ * @param path The path of the catalog file.
+ *
+ * @return The writer, or NULL if a file could not be created.
+ */
+CatalogWriter* createCatalogWriter(const char* path)
+{
+    CatalogWriter* writer = calloc(1, sizeof(CatalogWriter));
+    if (!writer || strlen(path) + 16 > sizeof(writer->path))
+    {
+        free(writer);
+        return NULL;
+    }
+
+    strcpy(writer->path, path);
+    for (int i = 0; i < CATALOG_BUCKETS; i++)
+    {
+        char bucket_path[4096 + 16];
+        getBucketPath(writer, i, bucket_path, sizeof(bucket_path));
+        writer->buckets[i] = fopen(bucket_path, "w+b");
+        if (!writer->buckets[i])
+        {
+            discardCatalogWriter(writer);
+            return NULL;
+        }
+    }
+    return writer;
+}
+
+/**
+ * @brief Grades a puzzle and adds it to the bucket of its size and grade.
+ *
+ * @return The grade of the puzzle, 0 if it was skipped because it has no
+ *         unique solution or an unsupported (e.g. rectangular) size, or -1
+ *         on an I/O error.
+ */
+int addToCatalog(CatalogWriter* writer, const Puzzle* puzzle)
+{
+    if (getBucket(puzzle->size, 1) < 0 || getHeight(puzzle) != puzzle->size || countSolutions(*puzzle, 2, NULL) != 1) { return 0; }
+
+    int grade = gradePuzzle(puzzle);
+    int bucket = getBucket(puzzle->size, grade);
+    unsigned long long empty = getEmpty(puzzle);
+    CatalogRecord record = { .grid = puzzle->grid & ~empty, .actions = empty };
+
+    if (fwrite(&record, sizeof(CatalogRecord), 1, writer->buckets[bucket]) != 1) { return -1; }
+    writer->counts[bucket]++;
+    return grade;
+}
+
+/**
+ * @brief Copies a temporary bucket file to the end of the catalog.
+ */
+static bool copyBucket(FILE* bucket, FILE* file)
+{
+    char buffer[1 << 16];
+    size_t length;
+
+    if (fseek(bucket, 0, SEEK_SET)) { return false; }
+    while ((length = fread(buffer, 1, sizeof(buffer), bucket)) > 0)
+    {
+        if (fwrite(buffer, 1, length, file) != length) { return false; }
+    }
+    return !ferror(bucket);
+}
+
+/**
+ * @brief Joins the buckets into the catalog and frees the writer.
+ *
+ * @return true if the catalog was written, false on an I/O error.
+ */
+bool closeCatalogWriter(CatalogWriter* writer)
+{
+    CatalogHeader header = { .magic = CATALOG_MAGIC, .grades = MAX_GRADE };
+    bool written = true;
+    for (int i = 0; i < CATALOG_BUCKETS; i++) { written = written && writer->buckets[i]; }
+
+    FILE* file = written ? fopen(writer->path, "wb") : NULL;
+    written = file && fwrite(&header, sizeof(CatalogHeader), 1, file) == 1;
+
+    unsigned long long offset = sizeof(CatalogHeader);
+    for (int i = 0; i < CATALOG_BUCKETS && written; i++)
+    {
+        header.buckets[i].offset = offset;
+        header.buckets[i].count = writer->counts[i];
+        written = copyBucket(writer->buckets[i], file);
+        offset += writer->counts[i] * sizeof(CatalogRecord);
+    }
+
+    written = written && !fseek(file, 0, SEEK_SET);
+    written = written && fwrite(&header, sizeof(CatalogHeader), 1, file) == 1;
+    if (file) { written = !fclose(file) && written; }
+
+    discardCatalogWriter(writer);
+    return written;
+}
+
+/**
+ * @brief Frees the writer without writing the catalog, e.g. after bad input.
+ *
+ * The temporary bucket files are removed and the file at the catalog's
+ * path, if any, is left as it was.
+ */
+void discardCatalogWriter(CatalogWriter* writer)
+{
+    for (int i = 0; i < CATALOG_BUCKETS; i++)
+    {
+        char bucket_path[4096 + 16];
+        if (writer->buckets[i]) { fclose(writer->buckets[i]); }
+        getBucketPath(writer, i, bucket_path, sizeof(bucket_path));
+        remove(bucket_path);
+    }
+    free(writer);
+}
+
+/**
+ * @brief Opens a catalog by mapping it into memory.
+ *
+ * @return The catalog, or NULL if the file is missing or not a catalog.
+ */
+Catalog* openCatalog(const char* path)
+{
+    Catalog* catalog = calloc(1, sizeof(Catalog));
+    struct stat status;
+
+    if (!catalog) { return NULL; }
+    catalog->fd = open(path, O_RDONLY);
+    if (catalog->fd < 0 || fstat(catalog->fd, &status) || status.st_size < (off_t) sizeof(CatalogHeader))
+    {
+        if (catalog->fd >= 0) { close(catalog->fd); }
+        free(catalog);
+        return NULL;
+    }
+
+    catalog->length = status.st_size;
+    void* data = mmap(NULL, catalog->length, PROT_READ, MAP_SHARED, catalog->fd, 0);
+    if (data == MAP_FAILED)
+    {
+        close(catalog->fd);
+        free(catalog);
+        return NULL;
+    }
+
+    catalog->data = data;
+    catalog->header = data;
+    bool valid = catalog->header->magic == CATALOG_MAGIC && catalog->header->grades == MAX_GRADE;
+    for (int i = 0; i < CATALOG_BUCKETS && valid; i++)
+    {
+        const CatalogBucket* bucket = &catalog->header->buckets[i];
+        valid = bucket->offset <= catalog->length &&
+            bucket->count <= (catalog->length - bucket->offset) / sizeof(CatalogRecord);
+    }
+    if (!valid)
+    {
+        closeCatalog(catalog);
+        return NULL;
+    }
+    return catalog;
+}
+
+void closeCatalog(Catalog* catalog)
+{
+    munmap((void*) catalog->data, catalog->length);
+    close(catalog->fd);
+    free(catalog);
+}
+
+/**
+ * @return The number of puzzles of a size and grade in the catalog.
+ */
+unsigned long long countCatalog(const Catalog* catalog, unsigned size, int grade)
+{
+    int bucket = getBucket(size, grade);
+    return bucket < 0 ? 0 : catalog->header->buckets[bucket].count;
+}
+
+/**
+ * @brief Reads the puzzle at a position in the bucket of a size and grade.
+ *
+ * @return false if there is no such puzzle.
+ */
+bool getFromCatalog(const Catalog* catalog, unsigned size, int grade, unsigned long long position, Puzzle* puzzle)
+{
+    if (position >= countCatalog(catalog, size, grade)) { return false; }
+
+    const CatalogBucket* bucket = &catalog->header->buckets[getBucket(size, grade)];
+    const CatalogRecord* record = (const CatalogRecord*) (catalog->data + bucket->offset) + position;
+    *puzzle = (Puzzle) { .grid = record->grid, .actions = record->actions, .size = size };
+    return true;
+}
+
+/**
+ * @brief Picks a puzzle of a size and grade in constant time.
+ *
+ * @param random A random number, e.g. from a per-request generator.
+ *
+ * @return false if the catalog has no puzzle of that size and grade.
+ */
+bool sampleCatalog(const Catalog* catalog, unsigned size, int grade, unsigned long long random, Puzzle* puzzle)
+{
+    unsigned long long count = countCatalog(catalog, size, grade);
+    return count && getFromCatalog(catalog, size, grade, random % count, puzzle);
+}
+
+/**
+ * @brief Reads the next puzzle of a cursor and advances it.
+ *
+ * A cursor is plain data, so it can be stored with the state of a client to
+ * hand out every puzzle of a bucket once, in catalog order.
+ *
+ * @return false once the bucket is exhausted.
+ */
+bool nextInCatalog(const Catalog* catalog, CatalogCursor* cursor, Puzzle* puzzle)
+{
+    if (!getFromCatalog(catalog, cursor->size, cursor->grade, cursor->next, puzzle)) { return false; }
+    cursor->next++;
+    return true;
+}
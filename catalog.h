@@ -0,0 +1,27 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include "takuzu.h"
+
+typedef struct CatalogWriter CatalogWriter;
+typedef struct Catalog Catalog;
+
+typedef struct
+{
+    unsigned size;
+    int grade;
+    unsigned long long next;
+} CatalogCursor;
+
+CatalogWriter* createCatalogWriter(const char* path);
+int addToCatalog(CatalogWriter* writer, const Puzzle* puzzle);
+bool closeCatalogWriter(CatalogWriter* writer);
+void discardCatalogWriter(CatalogWriter* writer);
+Catalog* openCatalog(const char* path);
+void closeCatalog(Catalog* catalog);
+unsigned long long countCatalog(const Catalog* catalog, unsigned size, int grade);
+bool getFromCatalog(const Catalog* catalog, unsigned size, int grade, unsigned long long position, Puzzle* puzzle);
+bool sampleCatalog(const Catalog* catalog, unsigned size, int grade, unsigned long long random, Puzzle* puzzle);
+bool nextInCatalog(const Catalog* catalog, CatalogCursor* cursor, Puzzle* puzzle);
+
+#endif
@@ -0,0 +1,889 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "count.h"
+
+#define BYTES(x) (0x0101010101010101ULL * (x))
+
+typedef struct
+{
+    unsigned long long columns;
+    unsigned long long used;
+    unsigned long long forward;
+    unsigned long long backward;
+} State;
+
+typedef struct
+{
+    State* states;
+    unsigned long long* tallies;
+    unsigned width;
+    unsigned long long capacity;
+    unsigned long long count;
+} Layer;
+
+typedef struct
+{
+    unsigned size;
+    int line_count;
+    unsigned long long lines[64];
+    unsigned long long clues[8];
+    unsigned long long near[8];
+    unsigned long long later[9];
+    unsigned long long row_grid[8];
+    unsigned long long row_clues[8];
+    unsigned long long ones[8];
+    unsigned long long zeros[8];
+    unsigned long long spread[64];
+    unsigned long long any_ones[256];
+    unsigned long long any_zeros[256];
+    unsigned clue_count;
+    unsigned char labels[64];
+} Table;
+
+/**
+ * @brief Generates every line that can appear in a solved puzzle.
+ *
+ * A line is a row or column of a solution: it is balanced and has no
+ * triplets, as far as the compiled rules ask for it. Candidates are
+ * generated in increasing order, so the index of a line in the table doubles
+ * as its lexicographic rank.
+ *
+ * @param size The length of the lines.
+ * @param lines The output table, large enough for MAX_LINES lines, or for
+ *              64 lines with the standard rules.
+ *
+ * @return The number of lines written to the table.
+ */
+int getLines(unsigned size, unsigned long long lines[])
+{
+    int count = 0;
+    for (unsigned long long line = 0; line < 1ULL << size; line++)
+    {
+        Puzzle candidate = { .grid = line, .actions = 0, .size = size };
+        if (isBalanced(&candidate) && !hasTriplets(&candidate))
+        {
+            lines[count++] = line;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Appends a line to every column of a DP state.
+ *
+ * A state holds one byte per column: bits 0-2 count the 1's placed so far,
+ * bits 3-4 hold the last two values and bits 5-7 name the column's class.
+ * Columns share a class as long as their prefixes are identical, so at the
+ * bottom of the grid the columns are unique iff all classes are distinct.
+ * Classes are relabelled in order of first occurrence to keep states
+ * canonical. The line must come from getCandidates().
+ *
+ * The counts and the last values of all columns are updated at once, with
+ * the line spread out to one bit per byte; only the relabelling needs a
+ * loop over the columns.
+ *
+ * @param columns The state of the columns before the line is placed.
+ * @param spread The line to place below them, bit c moved to byte c.
+ * @param size The size of the puzzle.
+ *
+ * @return The state of the columns after the line is placed.
+ */
+static unsigned long long advance(unsigned long long columns, unsigned long long spread, unsigned size)
+{
+    unsigned long long next = ((columns & BYTES(7)) + spread) | (columns & BYTES(0x08)) << 1 | spread << 3;
+    unsigned long long labels = 0;
+    unsigned label_count = 0;
+
+    for (unsigned c = 0; c < size; c++)
+    {
+        unsigned key = (columns >> (8 * c + 4) & 0x0E) | (spread >> 8 * c & 1);
+        unsigned long long label = labels >> 4 * key & 0xF;
+
+        if (!label)
+        {
+            label = ++label_count;
+            labels |= label << 4 * key;
+        }
+        next |= (label - 1) << (8 * c + 5);
+    }
+    return next;
+}
+
+/**
+ * @brief Gathers bit 0 of every byte into a mask with one bit per column.
+ */
+static unsigned getColumnMask(unsigned long long bytes)
+{
+    return (bytes & BYTES(1)) * 0x0102040810204080ULL >> 56;
+}
+
+/**
+ * @brief Finds the columns whose count of 1's equals a value.
+ */
+static unsigned findCount(unsigned long long columns, unsigned count)
+{
+    unsigned long long differ = (columns & BYTES(7)) ^ BYTES(count);
+    return getColumnMask(~((differ + BYTES(0x7F)) >> 7));
+}
+
+/**
+ * @brief Checks that no two columns of a completed state share a class.
+ */
+static bool hasUniqueColumns(unsigned long long columns, unsigned size)
+{
+    unsigned seen = 0;
+    for (unsigned c = 0; c < size; c++)
+    {
+        unsigned class = columns >> (8 * c + 5) & 7;
+        if (seen & 1U << class) { return false; }
+        seen |= 1U << class;
+    }
+    return true;
+}
+
+static unsigned long long hashState(unsigned long long columns, unsigned long long used)
+{
+    unsigned long long hash = columns ^ used * 0x9E3779B97F4A7C15ULL;
+    hash = (hash ^ hash >> 30) * 0xBF58476D1CE4E5B9ULL;
+    hash = (hash ^ hash >> 27) * 0x94D049BB133111EBULL;
+    return hash ^ hash >> 31;
+}
+
+/**
+ * @brief Finds the slot of a state in a layer, or the empty slot for it.
+ *
+ * Layers are open addressing tables with linear probing. Empty slots are
+ * recognised by a forward count of 0, which no reachable state has.
+ */
+static State* probeState(const Layer* layer, unsigned long long columns, unsigned long long used)
+{
+    unsigned long long mask = layer->capacity - 1;
+    for (unsigned long long i = hashState(columns, used) & mask;; i = (i + 1) & mask)
+    {
+        State* state = &layer->states[i];
+        if (!state->forward) { return state; }
+        if (state->columns == columns && state->used == used) { return state; }
+    }
+}
+
+/**
+ * @brief Returns the backward count of a state, 0 if it was never reached.
+ */
+static unsigned long long getBackward(const Layer* layer, unsigned long long columns, unsigned long long used)
+{
+    return layer->capacity ? probeState(layer, columns, used)->backward : 0;
+}
+
+/**
+ * @brief Makes room in a layer for a number of states without growing.
+ *
+ * The table doubles until it is at most three quarters full with that many
+ * states; the layers of 8x8 puzzles are large enough that a smaller table
+ * is faster, fewer of its pages and cache lines being touched. The tallies
+ * of the states, if the layer has any, move along with them.
+ *
+ * @return true on success, false if memory ran out.
+ */
+static bool reserveStates(Layer* layer, unsigned long long count)
+{
+    if (4 * count <= 3 * layer->capacity) { return true; }
+
+    Layer grown = { .width = layer->width, .capacity = layer->capacity ? layer->capacity : 1024, .count = 0 };
+    while (4 * count > 3 * grown.capacity) { grown.capacity *= 2; }
+    grown.states = calloc(grown.capacity, sizeof(State));
+    grown.tallies = layer->width ? calloc(grown.capacity * layer->width, sizeof(unsigned long long)) : NULL;
+    if (!grown.states || (layer->width && !grown.tallies))
+    {
+        free(grown.states);
+        free(grown.tallies);
+        return false;
+    }
+
+    for (unsigned long long i = 0; i < layer->capacity; i++)
+    {
+        State* state = &layer->states[i];
+        if (!state->forward) { continue; }
+
+        State* slot = probeState(&grown, state->columns, state->used);
+        *slot = *state;
+        if (layer->width)
+        {
+            memcpy(&grown.tallies[(slot - grown.states) * layer->width], &layer->tallies[i * layer->width],
+                layer->width * sizeof(unsigned long long));
+        }
+        grown.count++;
+    }
+    free(layer->states);
+    free(layer->tallies);
+    *layer = grown;
+    return true;
+}
+
+/**
+ * @brief Finds the slot of a state in a layer, inserting it if needed.
+ *
+ * The table doubles once three quarters full. A new state has a forward
+ * count and tallies of 0 until the caller adds to them.
+ *
+ * @return The slot of the state, or NULL if memory ran out.
+ */
+static State* findState(Layer* layer, unsigned long long columns, unsigned long long used)
+{
+    if (!reserveStates(layer, layer->count + 1)) { return NULL; }
+
+    State* state = probeState(layer, columns, used);
+    state->columns = columns;
+    state->used = used;
+    return state;
+}
+
+/**
+ * @brief Returns the tallies of the state in a slot, NULL if there are none.
+ */
+static unsigned long long* getTallies(const Layer* layer, unsigned long long slot)
+{
+    return layer->width ? &layer->tallies[slot * layer->width] : NULL;
+}
+
+static void freeLayers(Layer layers[], unsigned count)
+{
+    for (unsigned i = 0; i < count; i++)
+    {
+        free(layers[i].states);
+        free(layers[i].tallies);
+    }
+}
+
+/**
+ * @brief Prepares the lines that each row of a puzzle may take.
+ *
+ * clues[k] has bit j set if line j agrees with the clues of row k. If the
+ * table is relaxed, near[k] also allows lines that disagree with a single
+ * clue of row k, otherwise it equals clues[k]. later[k] has bit j set if
+ * near[k] does for any row from k onwards. ones[c] and zeros[c] have bit j
+ * set if line j has a 1 or a 0 in column c, and any_ones[m] and any_zeros[m]
+ * are their unions over the columns in the mask m. spread[j] is line j for
+ * advance(). labels[x] numbers clue x from 1 to clue_count, in cell order,
+ * and is 0 for empty cells.
+ */
+static void getTable(const Puzzle* puzzle, Table* table, bool relaxed)
+{
+    table->size = puzzle->size;
+    table->line_count = getLines(puzzle->size, table->lines);
+    table->later[puzzle->size] = 0;
+    table->clue_count = 0;
+    for (unsigned x = 0; x < 64; x++)
+    {
+        bool clue = x < puzzle->size * puzzle->size && !(puzzle->actions >> x & 1);
+        table->labels[x] = clue ? ++table->clue_count : 0;
+    }
+
+    for (unsigned c = 0; c < 8; c++)
+    {
+        table->ones[c] = 0;
+        table->zeros[c] = 0;
+        for (int j = 0; j < table->line_count && c < puzzle->size; j++)
+        {
+            if (table->lines[j] >> c & 1) { table->ones[c] |= 1ULL << j; }
+            else { table->zeros[c] |= 1ULL << j; }
+        }
+    }
+    for (int j = 0; j < table->line_count; j++)
+    {
+        table->spread[j] = 0;
+        for (unsigned c = 0; c < puzzle->size; c++) { table->spread[j] |= (table->lines[j] >> c & 1) << 8 * c; }
+    }
+    table->any_ones[0] = 0;
+    table->any_zeros[0] = 0;
+    for (unsigned mask = 1; mask < 256; mask++)
+    {
+        unsigned c = __builtin_ctz(mask);
+        table->any_ones[mask] = table->any_ones[mask & (mask - 1)] | table->ones[c];
+        table->any_zeros[mask] = table->any_zeros[mask & (mask - 1)] | table->zeros[c];
+    }
+
+    for (unsigned k = 0; k < puzzle->size; k++)
+    {
+        Puzzle row = getRow(puzzle, k);
+        table->row_grid[k] = row.grid;
+        table->row_clues[k] = ~row.actions & ((1ULL << puzzle->size) - 1);
+        table->clues[k] = 0;
+        table->near[k] = 0;
+
+        for (int j = 0; j < table->line_count; j++)
+        {
+            unsigned long long mismatch = (table->lines[j] ^ row.grid) & table->row_clues[k];
+            if (!mismatch) { table->clues[k] |= 1ULL << j; }
+            if (!mismatch || (relaxed && !(mismatch & (mismatch - 1)))) { table->near[k] |= 1ULL << j; }
+        }
+    }
+    for (unsigned k = puzzle->size; k-- > 0;)
+    {
+        table->later[k] = table->later[k+1] | table->near[k];
+    }
+}
+
+/**
+ * @brief Computes which lines can still be placed below a state.
+ *
+ * A line fits if every column that it sets to 1 can take another 1 and every
+ * column that it sets to 0 can take another 0, so full columns rule out the
+ * lines in table->ones or table->zeros. Whether a line that no longer fits
+ * was used does not matter anymore, so masking it out of the used set merges
+ * states that only differ in the past.
+ */
+static unsigned long long getPossible(const Table* table, unsigned depth, unsigned long long columns)
+{
+    unsigned half = table->size/2;
+    unsigned long long possible = table->later[depth] & ~table->any_ones[findCount(columns, half)];
+    if (depth >= half) { possible &= ~table->any_zeros[findCount(columns, depth - half)]; }
+    return possible;
+}
+
+/**
+ * @brief Computes which lines can be placed as row k below a state.
+ *
+ * On top of getPossible(), the line must agree with the clues of row k, must
+ * not have been used and must not extend a pair in a column to a triplet.
+ * In a relaxed table, a line may disagree with one clue, see relaxedPass().
+ */
+static unsigned long long getCandidates(const Table* table, unsigned k, const State* state)
+{
+    unsigned long long candidates = table->near[k] & ~state->used & getPossible(table, k, state->columns);
+    if (k < 2) { return candidates; }
+
+    unsigned long long last = state->columns >> 3;
+    candidates &= ~table->any_ones[getColumnMask(last & last >> 1)];
+    return candidates & ~table->any_zeros[getColumnMask(~(last | last >> 1))];
+}
+
+/**
+ * @brief Places line j as row k below a state.
+ */
+static State step(const Table* table, unsigned k, const State* state, int j)
+{
+    State next = { .columns = advance(state->columns, table->spread[j], table->size) };
+    next.used = (state->used | 1ULL << j) & getPossible(table, k + 1, next.columns);
+    return next;
+}
+
+/**
+ * @brief Builds the DP layers of a puzzle with their forward counts.
+ *
+ * Layer k holds every state reachable after placing k rows that agree with
+ * the clues, and the forward count of a state is the number of row prefixes
+ * that lead to it. Rows are unique because a state remembers which lines it
+ * has used.
+ *
+ * @param table The lines each row may take, from getTable().
+ * @param layers The size+1 layers to build, zero-initialised.
+ * @param first The lines row 0 may take, to split the work.
+ *
+ * @return true on success, false if memory ran out.
+ */
+static bool forwardPass(const Table* table, Layer layers[], unsigned long long first)
+{
+    unsigned size = table->size;
+
+    State* start = findState(&layers[0], 0, 0);
+    if (!start) { return false; }
+    start->forward = 1;
+    layers[0].count = 1;
+
+    for (unsigned k = 0; k < size; k++)
+    {
+        for (unsigned long long i = 0; i < layers[k].capacity; i++)
+        {
+            State state = layers[k].states[i];
+            if (!state.forward) { continue; }
+
+            unsigned long long candidates = getCandidates(table, k, &state) & (k ? -1ULL : first);
+            State keys[64];
+            int key_count = 0;
+
+            if (!reserveStates(&layers[k+1], layers[k+1].count + __builtin_popcountll(candidates))) { return false; }
+            for (unsigned long long rest = candidates; rest; rest &= rest - 1)
+            {
+                int j = __builtin_ctzll(rest);
+                keys[key_count] = step(table, k, &state, j);
+                __builtin_prefetch(&layers[k+1].states[hashState(keys[key_count].columns, keys[key_count].used) & (layers[k+1].capacity - 1)]);
+                key_count++;
+            }
+
+            for (int i = 0; i < key_count; i++)
+            {
+                State* next = findState(&layers[k+1], keys[i].columns, keys[i].used);
+                if (!next->forward) { layers[k+1].count++; }
+                next->forward += state.forward;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Builds the DP layers of a puzzle and fills in both passes.
+ *
+ * After forwardPass(), the backward pass records for each state how many
+ * completions lead from it to a solution.
+ *
+ * @param table The lines each row may take, from getTable().
+ * @param layers The size+1 layers to build, zero-initialised.
+ *
+ * @return true on success, false if memory ran out.
+ */
+static bool buildLayers(const Table* table, Layer layers[])
+{
+    unsigned size = table->size;
+    if (!forwardPass(table, layers, -1ULL)) { return false; }
+
+    for (unsigned long long i = 0; i < layers[size].capacity; i++)
+    {
+        State* state = &layers[size].states[i];
+        state->backward = state->forward && hasUniqueColumns(state->columns, size);
+    }
+
+    for (unsigned k = size; k-- > 0;)
+    {
+        for (unsigned long long i = 0; i < layers[k].capacity; i++)
+        {
+            State* state = &layers[k].states[i];
+            if (!state->forward) { continue; }
+
+            unsigned long long candidates = getCandidates(table, k, state);
+            for (int j = 0; j < table->line_count; j++)
+            {
+                if (!(candidates >> j & 1)) { continue; }
+                State key = step(table, k, state, j);
+                state->backward += getBackward(&layers[k+1], key.columns, key.used);
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Counts the solutions of a puzzle and how often each cell is 1.
+ *
+ * Instead of enumerating solutions, a row-wise counting DP is run over the
+ * puzzle. Its states summarise the columns (see advance()) and the set of
+ * rows used so far, so prefixes that can be completed in the same ways are
+ * merged. After the forward and backward passes, the number of solutions in
+ * which row k equals a line is the forward count of the state before it
+ * times the backward count of the state after it, which is added to every
+ * cell that the line sets to 1.
+ *
+ * @param puzzle The puzzle to be counted.
+ * @param marginals Receives the number of solutions and, per cell, the number
+ *                  of solutions in which that cell is 1.
+ *
+ * @return true on success, false if the size is not supported (including
+ *         rectangular grids), the rules are not the standard ones, the
+ *         puzzle has edge markers or memory ran out.
+ */
+bool countMarginals(const Puzzle* puzzle, Marginals* marginals)
+{
+    unsigned size = puzzle->size;
+    Layer layers[9] = { 0 };
+    Table table;
+
+    memset(marginals, 0, sizeof(*marginals));
+    if (!STANDARD_RULES || size % 2 || size > 8 || getHeight(puzzle) != size || hasEdges(puzzle)) { return false; }
+
+    getTable(puzzle, &table, false);
+    if (!buildLayers(&table, layers))
+    {
+        freeLayers(layers, size + 1);
+        return false;
+    }
+
+    for (unsigned k = 0; k < size; k++)
+    {
+        for (unsigned long long i = 0; i < layers[k].capacity; i++)
+        {
+            State state = layers[k].states[i];
+            if (!state.forward || !state.backward) { continue; }
+
+            unsigned long long candidates = getCandidates(&table, k, &state);
+            for (int j = 0; j < table.line_count; j++)
+            {
+                if (!(candidates >> j & 1)) { continue; }
+                State key = step(&table, k, &state, j);
+
+                unsigned long long solutions = state.forward * getBackward(&layers[k+1], key.columns, key.used);
+                for (unsigned c = 0; c < size; c++)
+                {
+                    if (table.lines[j] >> c & 1) { marginals->ones[k * size + c] += solutions; }
+                }
+            }
+        }
+    }
+
+    marginals->total = getBackward(&layers[0], 0, 0);
+    freeLayers(layers, size + 1);
+    return true;
+}
+
+/**
+ * @brief Returns the label of the clue of row k that line j violates, 0 if
+ *        it agrees with all of them.
+ */
+static unsigned getViolation(const Table* table, unsigned k, int j)
+{
+    unsigned long long mismatch = (table->lines[j] ^ table->row_grid[k]) & table->row_clues[k];
+    return mismatch ? table->labels[k * table->size + __builtin_ctzll(mismatch)] : 0;
+}
+
+/**
+ * @brief Places the last row below a state and adds the complete grid, if
+ *        any, to the totals of relaxedPass().
+ *
+ * Every column either has all its 1's or all its 0's by then, so the last
+ * row is forced and there is at most one candidate.
+ *
+ * @param table The lines each row may take.
+ * @param state A state with all rows but the last placed.
+ * @param violated The label of the clue the row before violated, 0 if none.
+ * @param tallies The tallies of the state before that row.
+ * @param agreeing The prefixes of that state that agree with all clues.
+ * @param totals The totals, see relaxedPass().
+ */
+static void finishGrid(const Table* table, const State* state, unsigned violated,
+                       const unsigned long long tallies[], unsigned long long agreeing, unsigned long long totals[])
+{
+    unsigned k = table->size - 1;
+    unsigned long long candidates = getCandidates(table, k, state);
+    if (!candidates) { return; }
+
+    int j = __builtin_ctzll(candidates);
+    if (!hasUniqueColumns(advance(state->columns, table->spread[j], table->size), table->size)) { return; }
+
+    unsigned label = getViolation(table, k, j);
+    if (label || violated)
+    {
+        if (!(label && violated)) { totals[label | violated] += agreeing; }
+        return;
+    }
+    totals[0] += agreeing;
+    for (unsigned i = 0; i < table->clue_count; i++) { totals[i + 1] += tallies[i]; }
+}
+
+/**
+ * @brief Counts the grids of a relaxed table by the clue they violate.
+ *
+ * The states are those of forwardPass(), but each also has one tally per
+ * clue: tally table->labels[x] - 1 counts the prefixes that violate clue x.
+ * The rest of the forward count are the prefixes that agree with all clues.
+ * Since all prefixes of a state have the same successors, each transition
+ * is computed once for all of them, however many clues the puzzle has. A
+ * line that violates a clue only extends the prefixes that agree with all
+ * clues, and only into the tally of that clue. The last two rows are not
+ * stored as layers, see finishGrid().
+ *
+ * @param table The lines each row may take, from a relaxed getTable().
+ * @param layers The size+1 layers to build, zero-initialised.
+ * @param first The lines row 0 may take, to split the work.
+ * @param totals Receives, added to it, the number of grids that agree with
+ *               all clues at index 0 and that violate clue x at index
+ *               table->labels[x].
+ *
+ * @return true on success, false if memory ran out.
+ */
+static bool relaxedPass(const Table* table, Layer layers[], unsigned long long first, unsigned long long totals[])
+{
+    unsigned size = table->size;
+    unsigned width = table->clue_count;
+
+    for (unsigned k = 0; k <= size; k++) { layers[k].width = width; }
+    State* start = findState(&layers[0], 0, 0);
+    if (!start) { return false; }
+    start->forward = 1;
+    layers[0].count = 1;
+
+    for (unsigned k = 0; k + 1 < size; k++)
+    {
+        for (unsigned long long i = 0; i < layers[k].capacity; i++)
+        {
+            State state = layers[k].states[i];
+            if (!state.forward) { continue; }
+
+            const unsigned long long* tallies = getTallies(&layers[k], i);
+            unsigned long long agreeing = state.forward;
+            for (unsigned label = 0; label < width; label++) { agreeing -= tallies[label]; }
+
+            unsigned long long candidates = getCandidates(table, k, &state) & (k ? -1ULL : first);
+            if (!agreeing) { candidates &= table->clues[k]; }
+
+            if (k + 2 == size)
+            {
+                for (unsigned long long rest = candidates; rest; rest &= rest - 1)
+                {
+                    int j = __builtin_ctzll(rest);
+                    State next = step(table, k, &state, j);
+                    finishGrid(table, &next, getViolation(table, k, j), tallies, agreeing, totals);
+                }
+                continue;
+            }
+
+            State keys[64];
+            int lines[64];
+            int key_count = 0;
+
+            if (!reserveStates(&layers[k+1], layers[k+1].count + __builtin_popcountll(candidates))) { return false; }
+            for (unsigned long long rest = candidates; rest; rest &= rest - 1)
+            {
+                int j = __builtin_ctzll(rest);
+                keys[key_count] = step(table, k, &state, j);
+                unsigned long long slot = hashState(keys[key_count].columns, keys[key_count].used) & (layers[k+1].capacity - 1);
+                __builtin_prefetch(&layers[k+1].states[slot]);
+                if (width) { __builtin_prefetch(getTallies(&layers[k+1], slot)); }
+                lines[key_count++] = j;
+            }
+
+            for (int n = 0; n < key_count; n++)
+            {
+                State* next = findState(&layers[k+1], keys[n].columns, keys[n].used);
+                unsigned long long* next_tallies = getTallies(&layers[k+1], next - layers[k+1].states);
+                unsigned label = getViolation(table, k, lines[n]);
+
+                if (!next->forward) { layers[k+1].count++; }
+                if (label)
+                {
+                    next_tallies[label - 1] += agreeing;
+                    next->forward += agreeing;
+                    continue;
+                }
+                for (unsigned i = 0; i < width; i++) { next_tallies[i] += tallies[i]; }
+                next->forward += state.forward;
+            }
+        }
+    }
+    return true;
+}
+
+typedef struct
+{
+    const Table* table;
+    unsigned long long first;
+    unsigned long long tallies[65];
+    bool failed;
+} Relaxation;
+
+/**
+ * @brief Runs the relaxed pass for some first rows, see relaxedPass().
+ */
+static void* runRelaxation(void* argument)
+{
+    Relaxation* relaxation = argument;
+    Layer layers[9] = { 0 };
+
+    relaxation->failed = !relaxedPass(relaxation->table, layers, relaxation->first, relaxation->tallies);
+    freeLayers(layers, relaxation->table->size + 1);
+    return NULL;
+}
+
+/**
+ * @brief Counts, for every clue, the solutions of the puzzle without it.
+ *
+ * A solution of the puzzle without clue x either agrees with x, and then is
+ * a solution of the puzzle itself, or violates x and agrees with all other
+ * clues. So instead of one count per clue, a single forward pass is run in
+ * which each grid may violate at most one clue, and the complete grids are
+ * tallied by the clue they violate (see relaxedPass()). The first row is
+ * dealt out over the threads, each of which runs its own pass.
+ *
+ * @param puzzle The puzzle to be analysed.
+ * @param counts Receives, per cell, the number of solutions without the
+ *               clue in that cell, or the number of solutions of the puzzle
+ *               if the cell is empty. It is zeroed if the count fails.
+ * @param threads The number of threads to count with, at most 64.
+ *
+ * @return true on success, false if the size is not supported (including
+ *         rectangular grids), the rules are not the standard ones, the
+ *         puzzle has edge markers or memory ran out.
+ */
+bool countWithoutClues(const Puzzle* puzzle, unsigned long long counts[], int threads)
+{
+    Table table;
+    Relaxation relaxations[64];
+    pthread_t ids[64];
+
+    memset(counts, 0, 64 * sizeof(unsigned long long));
+    if (!STANDARD_RULES || puzzle->size % 2 || puzzle->size > 8 || getHeight(puzzle) != puzzle->size || hasEdges(puzzle)) { return false; }
+    if (threads < 1) { threads = 1; }
+    if (threads > 64) { threads = 64; }
+
+    getTable(puzzle, &table, true);
+    for (int t = 0; t < threads; t++)
+    {
+        relaxations[t] = (Relaxation) { .table = &table, .first = 0, .failed = false };
+        memset(relaxations[t].tallies, 0, sizeof(relaxations[t].tallies));
+    }
+    for (int j = 0, t = 0; j < table.line_count; j++)
+    {
+        if (table.near[0] >> j & 1) { relaxations[t++ % threads].first |= 1ULL << j; }
+    }
+
+    int started = 1;
+    while (started < threads && !pthread_create(&ids[started], NULL, runRelaxation, &relaxations[started])) { started++; }
+    for (int t = started; t < threads; t++) { runRelaxation(&relaxations[t]); }
+    runRelaxation(&relaxations[0]);
+    for (int t = 1; t < started; t++) { pthread_join(ids[t], NULL); }
+
+    for (int t = 0; t < threads; t++)
+    {
+        if (relaxations[t].failed) { return false; }
+    }
+
+    for (int i = 0; i < puzzle->size*puzzle->size; i++)
+    {
+        for (int t = 0; t < threads; t++)
+        {
+            counts[i] += relaxations[t].tallies[0];
+            if (table.labels[i]) { counts[i] += relaxations[t].tallies[table.labels[i]]; }
+        }
+    }
+    return true;
+}
+
+struct Ranking
+{
+    Table table;
+    Layer layers[9];
+};
+
+/**
+ * @brief Prepares the ranking of all solution grids of a size.
+ *
+ * The layers of an empty puzzle are built once, after which every grid can
+ * be ranked and unranked by walking down the rows. Grids are ordered
+ * lexicographically by the line index of their rows, top row first.
+ *
+ * @param size The size of the grids, 4, 6 or 8.
+ *
+ * @return The ranking, or NULL if the size or the rules are not supported
+ *         or memory ran out. It must be released with freeRanking().
+ */
+Ranking* createRanking(unsigned size)
+{
+    if (!STANDARD_RULES || size % 2 || size > 8) { return NULL; }
+
+    Ranking* ranking = calloc(1, sizeof(Ranking));
+    if (!ranking) { return NULL; }
+
+    Puzzle empty = { .grid = 0, .actions = -1, .size = size };
+    getTable(&empty, &ranking->table, false);
+    if (!buildLayers(&ranking->table, ranking->layers))
+    {
+        freeRanking(ranking);
+        return NULL;
+    }
+    return ranking;
+}
+
+void freeRanking(Ranking* ranking)
+{
+    if (!ranking) { return; }
+    freeLayers(ranking->layers, ranking->table.size + 1);
+    free(ranking);
+}
+
+/**
+ * @brief Returns the number of solution grids, i.e. one more than the
+ *        largest rank.
+ */
+unsigned long long countGrids(const Ranking* ranking)
+{
+    return getBackward(&ranking->layers[0], 0, 0);
+}
+
+/**
+ * @brief Computes the grid with the given rank.
+ *
+ * In each row, the candidate lines are visited in order and the number of
+ * grids below each one is skipped until the rank falls within a line. A
+ * uniformly random rank thus gives a uniformly random grid.
+ *
+ * @param ranking The ranking from createRanking().
+ * @param rank The rank of the grid, smaller than countGrids().
+ * @param grid Receives the grid.
+ *
+ * @return true on success, false if the rank is out of range.
+ */
+bool unrankGrid(const Ranking* ranking, unsigned long long rank, Puzzle* grid)
+{
+    const Table* table = &ranking->table;
+    State state = { .columns = 0, .used = 0 };
+
+    if (rank >= countGrids(ranking)) { return false; }
+    *grid = (Puzzle) { .grid = 0, .actions = 0, .size = table->size };
+
+    for (unsigned k = 0; k < table->size; k++)
+    {
+        unsigned long long candidates = getCandidates(table, k, &state);
+        for (int j = 0; j < table->line_count; j++)
+        {
+            if (!(candidates >> j & 1)) { continue; }
+
+            State next = step(table, k, &state, j);
+            unsigned long long below = getBackward(&ranking->layers[k+1], next.columns, next.used);
+            if (rank < below)
+            {
+                grid->grid |= table->lines[j] << k * table->size;
+                state = next;
+                break;
+            }
+            rank -= below;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Computes the rank of a solution grid.
+ *
+ * The inverse of unrankGrid(): in each row, the grids below every candidate
+ * line that comes before the grid's own line are counted.
+ *
+ * @param ranking The ranking from createRanking().
+ * @param grid The grid to be ranked, of the ranking's size.
+ * @param rank Receives the rank.
+ *
+ * @return true on success, false if the grid is not a valid solution.
+ */
+bool rankGrid(const Ranking* ranking, const Puzzle* grid, unsigned long long* rank)
+{
+    const Table* table = &ranking->table;
+    State state = { .columns = 0, .used = 0 };
+
+    if (grid->size != table->size || getEmpty(grid)) { return false; }
+    *rank = 0;
+
+    for (unsigned k = 0; k < table->size; k++)
+    {
+        unsigned long long line = getRow(grid, k).grid;
+        unsigned long long candidates = getCandidates(table, k, &state);
+        bool found = false;
+
+        for (int j = 0; j < table->line_count && !found; j++)
+        {
+            if (!(candidates >> j & 1)) { continue; }
+
+            State next = step(table, k, &state, j);
+            unsigned long long below = getBackward(&ranking->layers[k+1], next.columns, next.used);
+            if (table->lines[j] == line)
+            {
+                if (!below) { return false; }
+                found = true;
+                state = next;
+            }
+            else
+            {
+                *rank += below;
+            }
+        }
+        if (!found) { return false; }
+    }
+    return true;
+}
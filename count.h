@@ -0,0 +1,25 @@
+#ifndef COUNT_H
+#define COUNT_H
+
+#include "takuzu.h"
+
+#define MAX_LINES 256
+
+typedef struct
+{
+    unsigned long long total;
+    unsigned long long ones[64];
+} Marginals;
+
+typedef struct Ranking Ranking;
+
+bool countMarginals(const Puzzle* puzzle, Marginals* marginals);
+bool countWithoutClues(const Puzzle* puzzle, unsigned long long counts[], int threads);
+int getLines(unsigned size, unsigned long long lines[]);
+Ranking* createRanking(unsigned size);
+void freeRanking(Ranking* ranking);
+unsigned long long countGrids(const Ranking* ranking);
+bool unrankGrid(const Ranking* ranking, unsigned long long rank, Puzzle* grid);
+bool rankGrid(const Ranking* ranking, const Puzzle* grid, unsigned long long* rank);
+
+#endif
@@ -0,0 +1,167 @@
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+
+static const char* event_names[COUNTER_EVENTS] = { "cycles", "instructions", "branch-misses", "cache-misses" };
+static const char* phase_names[PHASES] = { "parse", "propagate", "search", "output" };
+
+static double getTime(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Opens one hardware counter for this process and its future
+ *        threads.
+ *
+ * Only user space is counted, which is what containers and the default
+ * perf_event_paranoid setting usually allow.
+ *
+ * @return The file descriptor of the counter, or -1 with errno set.
+ */
+static int openEvent(int event)
+{
+#ifdef __linux__
+    static const unsigned long long configs[COUNTER_EVENTS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_MISSES
+    };
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = configs[event];
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static unsigned long long readEvent(int fd)
+{
+    unsigned long long value = 0;
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) { return 0; }
+    return value;
+}
+
+/**
+ * @brief Opens the hardware counters and starts timing the parse phase.
+ *
+ * Each counter is opened on its own, so a run reports whatever subset the
+ * kernel, the CPU or the container allows; wall-clock time per phase is
+ * always available. Counters of threads started after this call are added
+ * to the totals once those threads have exited.
+ *
+ * @param counters The counters to be opened.
+ *
+ * @return true if at least one hardware counter is available.
+ */
+bool openCounters(Counters* counters)
+{
+    memset(counters, 0, sizeof(*counters));
+    bool available = false;
+    for (int i = 0; i < COUNTER_EVENTS; i++)
+    {
+        counters->fds[i] = openEvent(i);
+        if (counters->fds[i] < 0 && !counters->error) { counters->error = errno; }
+        available = available || counters->fds[i] >= 0;
+    }
+
+    counters->phase = -1;
+    enterPhase(counters, PHASE_PARSE);
+    return available;
+}
+
+/**
+ * @brief Ends the current phase and starts another one.
+ *
+ * The counters keep running; only their values at the switch are read, so
+ * a phase can be entered any number of times and its totals add up.
+ */
+void enterPhase(Counters* counters, Phase phase)
+{
+    double now = getTime();
+    for (int i = 0; i < COUNTER_EVENTS; i++)
+    {
+        unsigned long long value = readEvent(counters->fds[i]);
+        if (counters->phase >= 0) { counters->totals[counters->phase][i] += value - counters->start[i]; }
+        counters->start[i] = value;
+    }
+    if (counters->phase >= 0) { counters->seconds[counters->phase] += now - counters->phase_start; }
+
+    counters->phase = phase;
+    counters->phase_start = now;
+}
+
+/**
+ * @brief Ends the current phase without starting another one.
+ */
+void stopCounters(Counters* counters)
+{
+    enterPhase(counters, PHASE_PARSE);
+    counters->phase = -1;
+}
+
+/**
+ * @brief Prints a table of the counters per phase.
+ *
+ * Counters that could not be opened are shown as n/a, together with the
+ * reason the first of them failed.
+ */
+void printCounters(const Counters* counters, FILE* output)
+{
+    fprintf(output, "%-10s %10s", "phase", "ms");
+    for (int i = 0; i < COUNTER_EVENTS; i++) { fprintf(output, " %14s", event_names[i]); }
+    fprintf(output, " %6s\n", "IPC");
+
+    for (int p = 0; p < PHASES; p++)
+    {
+        fprintf(output, "%-10s %10.3f", phase_names[p], counters->seconds[p] * 1e3);
+        for (int i = 0; i < COUNTER_EVENTS; i++)
+        {
+            if (counters->fds[i] < 0) { fprintf(output, " %14s", "n/a"); }
+            else { fprintf(output, " %14llu", counters->totals[p][i]); }
+        }
+
+        if (counters->fds[0] < 0 || counters->fds[1] < 0 || !counters->totals[p][0]) { fprintf(output, " %6s\n", "n/a"); }
+        else { fprintf(output, " %6.2f\n", (double) counters->totals[p][1] / counters->totals[p][0]); }
+    }
+
+    if (counters->error)
+    {
+        fprintf(output, "Some counters are unavailable: %s.\n", strerror(counters->error));
+        if (counters->error == EACCES || counters->error == EPERM)
+        {
+            fprintf(output, "Check /proc/sys/kernel/perf_event_paranoid or the container's seccomp profile.\n");
+        }
+        else if (counters->error == ENOENT || counters->error == ENODEV || counters->error == ENOSYS)
+        {
+            fprintf(output, "The CPU or the virtual machine does not expose hardware counters.\n");
+        }
+    }
+}
+
+void closeCounters(Counters* counters)
+{
+    for (int i = 0; i < COUNTER_EVENTS; i++)
+    {
+        if (counters->fds[i] >= 0) { close(counters->fds[i]); }
+        counters->fds[i] = -1;
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <stdio.h>
+#include "takuzu.h"
+
+#define COUNTER_EVENTS 4
+
+typedef enum
+{
+    PHASE_PARSE,
+    PHASE_PROPAGATE,
+    PHASE_SEARCH,
+    PHASE_OUTPUT,
+    PHASES
+} Phase;
+
+typedef struct
+{
+    int fds[COUNTER_EVENTS];
+    int error;
+    int phase;
+    double phase_start;
+    unsigned long long start[COUNTER_EVENTS];
+    unsigned long long totals[PHASES][COUNTER_EVENTS];
+    double seconds[PHASES];
+} Counters;
+
+bool openCounters(Counters* counters);
+void enterPhase(Counters* counters, Phase phase);
+void stopCounters(Counters* counters);
+void printCounters(const Counters* counters, FILE* output);
+void closeCounters(Counters* counters);
+
+#endif
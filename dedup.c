@@ -0,0 +1,359 @@
+#include <stdlib.h>
+#include <string.h>
+#include "dedup.h"
+#include "symmetry.h"
+
+#define PARTITION_BITS 6
+#define PARTITIONS (1 << PARTITION_BITS)
+#define MAX_LEVEL ((64 - PARTITION_BITS) / PARTITION_BITS)
+
+
+typedef struct
+{
+    unsigned long long grid;
+    unsigned long long actions;
+} Key;
+
+typedef struct
+{
+    Key* keys;
+    bool* used;
+    size_t capacity;
+    size_t count;
+} KeySet;
+
+typedef struct
+{
+    Key canonical;
+    Key original;
+    unsigned size;
+} Record;
+
+struct Dedup
+{
+    KeySet sets[3];
+    bool spilling[3];
+    size_t capacity;
+    FILE* output;
+    FILE* partitions[PARTITIONS];
+    char spill_path[4096];
+    bool failed;
+    DedupStats stats;
+};
+
+static unsigned long long hashKey(const Key* key)
+{
+    unsigned long long hash = key->grid ^ key->actions * 0x9E3779B97F4A7C15ULL;
+    hash = (hash ^ hash >> 30) * 0xBF58476D1CE4E5B9ULL;
+    hash = (hash ^ hash >> 27) * 0x94D049BB133111EBULL;
+    return hash ^ hash >> 31;
+}
+
+static bool createKeySet(KeySet* set, size_t capacity)
+{
+    set->keys = malloc(capacity * sizeof(Key));
+    set->used = calloc(capacity, sizeof(bool));
+    set->capacity = capacity;
+    set->count = 0;
+    return set->keys && set->used;
+}
+
+static void freeKeySet(KeySet* set)
+{
+    free(set->keys);
+    free(set->used);
+    set->keys = NULL;
+    set->used = NULL;
+}
+
+/**
+ * @brief Looks up a key in an open addressing set with linear probing.
+ *
+ * @param set The set to search.
+ * @param key The key to look for.
+ * @param insert Whether to insert the key if it is missing.
+ *
+ * @return true if the key was already in the set.
+ */
+static bool findKey(KeySet* set, const Key* key, bool insert)
+{
+    size_t mask = set->capacity - 1;
+    for (size_t i = hashKey(key) & mask;; i = (i + 1) & mask)
+    {
+        if (!set->used[i])
+        {
+            if (insert)
+            {
+                set->used[i] = true;
+                set->keys[i] = *key;
+                set->count++;
+            }
+            return false;
+        }
+        if (set->keys[i].grid == key->grid && set->keys[i].actions == key->actions) { return true; }
+    }
+}
+
+/**
+ * @brief Grows a set to twice its capacity, used for partitions only.
+ *
+ * @return false if memory ran out, in which case the set is unchanged.
+ */
+static bool growKeySet(KeySet* set)
+{
+    KeySet grown;
+    if (!createKeySet(&grown, 2 * set->capacity))
+    {
+        freeKeySet(&grown);
+        return false;
+    }
+    for (size_t i = 0; i < set->capacity; i++)
+    {
+        if (set->used[i]) { findKey(&grown, &set->keys[i], true); }
+    }
+    freeKeySet(set);
+    *set = grown;
+    return true;
+}
+
+/**
+ * @brief Picks the partition of a key at a level of partitioning.
+ *
+ * Each level uses the next PARTITION_BITS bits of the hash from the top,
+ * so the keys of a partition still spread over the slots of a set, which
+ * use the low bits.
+ */
+static int getPartition(const Key* key, int level)
+{
+    return hashKey(key) >> (64 - PARTITION_BITS * (level + 1)) & (PARTITIONS - 1);
+}
+
+static Key getKey(const Puzzle* puzzle)
+{
+    return (Key) { .grid = puzzle->grid, .actions = getEmpty(puzzle) };
+}
+
+static bool writePuzzle(Dedup* dedup, const Puzzle* puzzle)
+{
+    char puzzleString[MAX_PUZZLE_STRING];
+    formatPuzzle(puzzle, puzzleString);
+    dedup->stats.unique++;
+    return fprintf(dedup->output, "'%s'\n", puzzleString) > 0;
+}
+
+/**
+ * @brief Starts deduplicating a stream of puzzles.
+ *
+ * Puzzles are identified by their canonical form (see getCanonical()), so
+ * a puzzle is a duplicate if it is a rotation, reflection or complement of
+ * an earlier one. Each size has its own set of canonical forms, which share
+ * the memory budget. Unique puzzles are written to the output as puzzle
+ * strings in quotes, as printed by --generate, as soon as they are seen.
+ *
+ * @param memory The number of bytes the sets may use.
+ * @param spillPath The prefix of the partition files used once the sets are
+ *                  full.
+ * @param output The stream unique puzzles are written to.
+ *
+ * @return The deduplicator, or NULL if memory ran out.
+ */
+Dedup* createDedup(size_t memory, const char* spillPath, FILE* output)
+{
+    Dedup* dedup = calloc(1, sizeof(Dedup));
+    if (!dedup || strlen(spillPath) + 4 * (MAX_LEVEL + 1) > sizeof(dedup->spill_path))
+    {
+        free(dedup);
+        return NULL;
+    }
+
+    dedup->capacity = 1024;
+    while (3 * 2 * dedup->capacity * (sizeof(Key) + sizeof(bool)) <= memory) { dedup->capacity *= 2; }
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (!createKeySet(&dedup->sets[i], dedup->capacity))
+        {
+            for (int j = 0; j <= i; j++) { freeKeySet(&dedup->sets[j]); }
+            free(dedup);
+            return NULL;
+        }
+    }
+
+    strcpy(dedup->spill_path, spillPath);
+    dedup->output = output;
+    return dedup;
+}
+
+/**
+ * @brief Creates the partition files prefix0 to prefix63.
+ *
+ * @return false if a file could not be created; the files created so far
+ *         are left in files[] for closePartitions().
+ */
+static bool openPartitions(const char* prefix, FILE* files[])
+{
+    for (int i = 0; i < PARTITIONS; i++)
+    {
+        char path[4096 + 16];
+        snprintf(path, sizeof(path), "%s%d", prefix, i);
+        files[i] = fopen(path, "w+b");
+        if (!files[i]) { return false; }
+    }
+    return true;
+}
+
+/**
+ * @brief Closes and removes every partition file that was created.
+ */
+static void closePartitions(const char* prefix, FILE* files[])
+{
+    for (int i = 0; i < PARTITIONS; i++)
+    {
+        if (!files[i]) { continue; }
+
+        char path[4096 + 16];
+        snprintf(path, sizeof(path), "%s%d", prefix, i);
+        fclose(files[i]);
+        remove(path);
+        files[i] = NULL;
+    }
+}
+
+/**
+ * @brief Adds one puzzle of the stream.
+ *
+ * @return false on an I/O error or an unsupported size, including any
+ *         rectangular puzzle since the symmetries transpose the grid.
+ */
+bool addToDedup(Dedup* dedup, const Puzzle* puzzle)
+{
+    if (dedup->failed || puzzle->size % 2 || puzzle->size < 4 || puzzle->size > 8 || getHeight(puzzle) != puzzle->size) { return false; }
+
+    Puzzle canonical = getCanonical(puzzle, NULL);
+    Key key = getKey(&canonical);
+    int index = puzzle->size/2 - 2;
+    KeySet* set = &dedup->sets[index];
+    dedup->stats.seen++;
+
+    if (!dedup->spilling[index] && 10 * (set->count + 1) > 7 * set->capacity)
+    {
+        dedup->spilling[index] = true;
+        if (!dedup->partitions[0] && !openPartitions(dedup->spill_path, dedup->partitions))
+        {
+            dedup->failed = true;
+            return false;
+        }
+    }
+
+    if (findKey(set, &key, !dedup->spilling[index])) { return true; }
+    if (!dedup->spilling[index]) { return writePuzzle(dedup, puzzle); }
+
+    Record record = { .canonical = key, .original = getKey(puzzle), .size = puzzle->size };
+    if (fwrite(&record, sizeof(Record), 1, dedup->partitions[getPartition(&key, 0)]) != 1)
+    {
+        dedup->failed = true;
+        return false;
+    }
+    dedup->stats.spilled++;
+    return true;
+}
+
+/**
+ * @brief Deduplicates one partition file in memory.
+ *
+ * Works like the stream itself: the sets grow up to the capacity of the
+ * sets of the stream, so the memory budget holds, and once a set is 70%
+ * full the records of its size that are not in it are split into
+ * sub-partitions by the next bits of their hash, which are deduplicated
+ * one at a time after the sets are freed. Only at the last level, where all
+ * keys of a partition share their hash bits, are the sets grown further.
+ *
+ * @param dedup The deduplicator.
+ * @param file The partition file.
+ * @param path The path of the partition file.
+ * @param level The level of the partition, 0 for those of the stream.
+ *
+ * @return true on success, false on an I/O error or if memory ran out.
+ */
+static bool finishPartition(Dedup* dedup, FILE* file, const char* path, int level)
+{
+    KeySet sets[3] = { 0 };
+    bool spilling[3] = { false };
+    FILE* children[PARTITIONS] = { NULL };
+    char prefix[4096 + 16];
+    Record record;
+    bool finished = !fseek(file, 0, SEEK_SET) && snprintf(prefix, sizeof(prefix), "%s.", path) < sizeof(prefix);
+
+    for (int i = 0; i < 3 && finished; i++) { finished = createKeySet(&sets[i], 1024); }
+
+    while (finished && fread(&record, sizeof(Record), 1, file) == 1)
+    {
+        int index = record.size/2 - 2;
+        KeySet* set = &sets[index];
+        if (!spilling[index] && 10 * (set->count + 1) > 7 * set->capacity)
+        {
+            if (set->capacity < dedup->capacity || level == MAX_LEVEL) { finished = growKeySet(set); }
+            else
+            {
+                spilling[index] = true;
+                finished = children[0] || openPartitions(prefix, children);
+            }
+            if (!finished) { break; }
+        }
+
+        if (findKey(set, &record.canonical, !spilling[index])) { continue; }
+        if (!spilling[index])
+        {
+            Puzzle original = { .grid = record.original.grid, .actions = record.original.actions, .size = record.size };
+            finished = writePuzzle(dedup, &original);
+        }
+        else
+        {
+            finished = fwrite(&record, sizeof(Record), 1, children[getPartition(&record.canonical, level + 1)]) == 1;
+        }
+    }
+    finished = finished && !ferror(file);
+    for (int i = 0; i < 3; i++) { freeKeySet(&sets[i]); }
+
+    for (int i = 0; i < PARTITIONS && finished && children[i]; i++)
+    {
+        char child_path[4096 + 32];
+        snprintf(child_path, sizeof(child_path), "%s%d", prefix, i);
+        finished = finishPartition(dedup, children[i], child_path, level + 1);
+    }
+    closePartitions(prefix, children);
+    return finished;
+}
+
+/**
+ * @brief Writes the unique puzzles of the partitions and frees everything.
+ *
+ * Each partition holds only puzzles that were not in the sets, and all
+ * symmetric copies of a puzzle share a partition, so partitions can be
+ * deduplicated one at a time with fresh sets, see finishPartition(). The
+ * partition files are removed, also after an error.
+ *
+ * @param dedup The deduplicator to finish.
+ * @param stats Receives the number of puzzles seen, written and spilled. May
+ *              be NULL.
+ *
+ * @return true on success, false if an I/O error occurred at any point.
+ */
+bool finishDedup(Dedup* dedup, DedupStats* stats)
+{
+    bool finished = !dedup->failed;
+    for (int i = 0; i < 3; i++) { freeKeySet(&dedup->sets[i]); }
+
+    for (int i = 0; i < PARTITIONS && finished && dedup->partitions[i]; i++)
+    {
+        char path[4096 + 16];
+        snprintf(path, sizeof(path), "%s%d", dedup->spill_path, i);
+        finished = finishPartition(dedup, dedup->partitions[i], path, 0);
+    }
+    closePartitions(dedup->spill_path, dedup->partitions);
+
+    finished = !fflush(dedup->output) && finished;
+    if (stats) { *stats = dedup->stats; }
+    free(dedup);
+    return finished;
+}
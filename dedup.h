@@ -0,0 +1,21 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "takuzu.h"
+
+typedef struct Dedup Dedup;
+
+typedef struct
+{
+    unsigned long long seen;
+    unsigned long long unique;
+    unsigned long long spilled;
+} DedupStats;
+
+Dedup* createDedup(size_t memory, const char* spillPath, FILE* output);
+bool addToDedup(Dedup* dedup, const Puzzle* puzzle);
+bool finishDedup(Dedup* dedup, DedupStats* stats);
+
+#endif
@@ -0,0 +1,206 @@
+#include <string.h>
+#include "dispatch.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAS_X86_KERNELS 1
+#else
+#define HAS_X86_KERNELS 0
+#endif
+
+
+static const char* level_names[] = { "generic", "popcnt", "bmi2", "avx2", "avx512" };
+static CpuLevel selected = CPU_GENERIC;
+
+bool (*isValidKernel)(const Puzzle* puzzle) = isValidGeneric;
+
+#if HAS_X86_KERNELS
+
+/**
+ * @brief Checks a set of rows or columns as bit lines, all at once per line.
+ *
+ * Same rules as isBalanced() and hasTriplets(), but with whole-line bit
+ * operations: the filled in 1's and 0's are counted with popcount, and a
+ * run of RULE_MAX_RUN+1 equal cells is found by AND-ing the 1's (or 0's)
+ * with themselves shifted by 1 up to RULE_MAX_RUN. Full lines are checked
+ * for uniqueness like in isValid(). Always inlined, so popcount compiles to
+ * the instruction of the calling kernel.
+ *
+ * @param lines The values of the lines.
+ * @param empty The empty cells of the lines.
+ * @param count The number of lines.
+ * @param length The number of cells per line.
+ *
+ * @return true if all lines are valid, false otherwise.
+ */
+static inline __attribute__((always_inline)) bool checkLines(const unsigned long long lines[], const unsigned long long empty[], unsigned count, unsigned length)
+{
+    unsigned long long full = (1ULL << length) - 1;
+    for (unsigned i = 0; i < count; i++)
+    {
+        unsigned long long ones = lines[i] & ~empty[i] & full;
+        unsigned long long zeros = ~lines[i] & ~empty[i] & full;
+
+        if (RULE_BALANCED && (__builtin_popcountll(ones) > length/2 || __builtin_popcountll(zeros) > length/2)) { return false; }
+
+        unsigned long long run_ones = ones;
+        unsigned long long run_zeros = zeros;
+        for (int k = 1; k <= RULE_MAX_RUN; k++)
+        {
+            run_ones &= ones >> k;
+            run_zeros &= zeros >> k;
+        }
+        if (run_ones | run_zeros) { return false; }
+
+        if (!RULE_UNIQUE || empty[i] & full) { continue; }
+        for (unsigned j = 0; j < i; j++)
+        {
+            if (!(empty[j] & full) && lines[j] == lines[i]) { return false; }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief The isValid() kernel for CPUs with POPCNT.
+ *
+ * Rows are shifted out of the board, columns are gathered bit by bit.
+ */
+__attribute__((target("popcnt"))) static bool isValidPopcnt(const Puzzle* puzzle)
+{
+    if (!meetsEdges(puzzle)) { return false; }
+
+    unsigned size = puzzle->size;
+    unsigned height = getHeight(puzzle);
+    unsigned long long row_mask = (1ULL << size) - 1;
+    unsigned long long rows[16], row_empty[16], cols[16], col_empty[16];
+
+    for (unsigned r = 0; r < height; r++)
+    {
+        rows[r] = puzzle->grid >> r * size & row_mask;
+        row_empty[r] = puzzle->actions >> r * size & row_mask;
+    }
+    for (unsigned c = 0; c < size; c++)
+    {
+        cols[c] = col_empty[c] = 0;
+        for (unsigned r = 0; r < height; r++)
+        {
+            cols[c] |= (puzzle->grid >> (r * size + c) & 1ULL) << r;
+            col_empty[c] |= (puzzle->actions >> (r * size + c) & 1ULL) << r;
+        }
+    }
+    return checkLines(rows, row_empty, height, size) && checkLines(cols, col_empty, size, height);
+}
+
+/**
+ * @brief The isValid() kernel for CPUs with BMI2 and POPCNT.
+ *
+ * Like isValidPopcnt(), but each column is gathered with a single PEXT of
+ * the board shifted to the column, using a mask with one bit per row.
+ */
+__attribute__((target("bmi2,popcnt"))) static bool isValidBmi2(const Puzzle* puzzle)
+{
+    if (!meetsEdges(puzzle)) { return false; }
+
+    unsigned size = puzzle->size;
+    unsigned height = getHeight(puzzle);
+    unsigned long long row_mask = (1ULL << size) - 1;
+    unsigned long long col_mask = 0;
+    unsigned long long rows[16], row_empty[16], cols[16], col_empty[16];
+
+    for (unsigned r = 0; r < height; r++)
+    {
+        rows[r] = puzzle->grid >> r * size & row_mask;
+        row_empty[r] = puzzle->actions >> r * size & row_mask;
+        col_mask |= 1ULL << r * size;
+    }
+    for (unsigned c = 0; c < size; c++)
+    {
+        cols[c] = _pext_u64(puzzle->grid >> c, col_mask);
+        col_empty[c] = _pext_u64(puzzle->actions >> c, col_mask);
+    }
+    return checkLines(rows, row_empty, height, size) && checkLines(cols, col_empty, size, height);
+}
+
+#endif
+
+/**
+ * @brief Detects the best kernel level the CPU supports.
+ *
+ * AVX2 and AVX-512 are detected and reported, but a board is a single
+ * 64-bit word, so no kernel gains from vector registers and those levels
+ * run the BMI2 kernels.
+ */
+CpuLevel detectCpuLevel(void)
+{
+#if HAS_X86_KERNELS
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("popcnt")) { return CPU_GENERIC; }
+    if (!__builtin_cpu_supports("bmi2")) { return CPU_POPCNT; }
+    if (__builtin_cpu_supports("avx512f")) { return CPU_AVX512; }
+    if (__builtin_cpu_supports("avx2")) { return CPU_AVX2; }
+    return CPU_BMI2;
+#else
+    return CPU_GENERIC;
+#endif
+}
+
+CpuLevel getCpuLevel(void)
+{
+    return selected;
+}
+
+/**
+ * @brief Selects the kernels of a level, e.g. to compare levels in a
+ *        benchmark.
+ *
+ * Must not be called while other threads use the kernels.
+ *
+ * @param level The level to select.
+ *
+ * @return false if the CPU does not support the level, in which case the
+ *         selection is unchanged.
+ */
+bool forceCpuLevel(CpuLevel level)
+{
+    if (level < CPU_GENERIC || level > detectCpuLevel()) { return false; }
+
+    selected = level;
+    isValidKernel = isValidGeneric;
+#if HAS_X86_KERNELS
+    if (level >= CPU_POPCNT) { isValidKernel = isValidPopcnt; }
+    if (level >= CPU_BMI2) { isValidKernel = isValidBmi2; }
+#endif
+    return true;
+}
+
+const char* getCpuLevelName(CpuLevel level)
+{
+    return level >= CPU_GENERIC && level <= CPU_AVX512 ? level_names[level] : "unknown";
+}
+
+/**
+ * @brief Looks up a level by its name, as returned by getCpuLevelName().
+ *
+ * @return false if there is no level of that name.
+ */
+bool parseCpuLevel(const char* name, CpuLevel* level)
+{
+    for (int i = CPU_GENERIC; i <= CPU_AVX512; i++)
+    {
+        if (!strcmp(name, level_names[i]))
+        {
+            *level = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Selects the best kernels at startup, before main() runs.
+ */
+__attribute__((constructor)) static void initKernels(void)
+{
+    forceCpuLevel(detectCpuLevel());
+}
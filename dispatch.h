@@ -0,0 +1,23 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include "takuzu.h"
+
+typedef enum
+{
+    CPU_GENERIC,
+    CPU_POPCNT,
+    CPU_BMI2,
+    CPU_AVX2,
+    CPU_AVX512
+} CpuLevel;
+
+extern bool (*isValidKernel)(const Puzzle* puzzle);
+
+CpuLevel detectCpuLevel(void);
+CpuLevel getCpuLevel(void);
+bool forceCpuLevel(CpuLevel level);
+const char* getCpuLevelName(CpuLevel level);
+bool parseCpuLevel(const char* name, CpuLevel* level);
+
+#endif
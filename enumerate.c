@@ -0,0 +1,310 @@
+#include "enumerate.h"
+#include "count.h"
+#include "symmetry.h"
+
+
+typedef struct
+{
+    const Puzzle* puzzle;
+    bool canonical;
+    unsigned group;
+    unsigned depth;
+    SolutionCallback callback;
+    void* context;
+    unsigned long long lines[MAX_LINES];
+    int line_count;
+    unsigned long long count;
+    bool stopped;
+} Enumeration;
+
+/**
+ * @brief Finds the symmetries that map a puzzle onto itself.
+ *
+ * Only these map the solutions of the puzzle onto solutions, so canonical
+ * forms and orbits are taken under them: all 16 for an empty board, fewer
+ * once clues break the symmetry.
+ *
+ * @return A mask with bit s set if symmetry s leaves the puzzle unchanged.
+ */
+static unsigned getPuzzleGroup(const Puzzle* puzzle)
+{
+    unsigned group = 0;
+    for (int symmetry = 0; symmetry < SYMMETRIES; symmetry++)
+    {
+        Puzzle image = transformPuzzle(puzzle, symmetry);
+        if (!comparePuzzles(&image, puzzle)) { group |= 1U << symmetry; }
+    }
+    return group;
+}
+
+/**
+ * @brief Checks if a partial grid can still be the start of a canonical one.
+ *
+ * Only the symmetries that keep every row in place (mirroring the columns,
+ * complementing and both) map the first k rows onto the first k rows, so
+ * those of them in the group are applied to each row directly. If one of
+ * them yields a smaller prefix, every completion has a smaller image and is
+ * not canonical. The other symmetries are checked on complete grids.
+ *
+ * @param partial The grid with its first k rows filled in.
+ * @param k The number of rows filled in.
+ * @param group The symmetries of the puzzle, from getPuzzleGroup().
+ *
+ * @return false if no completion of the prefix can be canonical.
+ */
+static bool isCanonicalPrefix(const Puzzle* partial, unsigned k, unsigned group)
+{
+    unsigned size = partial->size;
+    unsigned long long full = (1ULL << size) - 1;
+    bool open[3] = { group >> 1 & 1, group >> 8 & 1, group >> 9 & 1 };
+
+    for (unsigned r = 0; r < k; r++)
+    {
+        unsigned long long row = getRow(partial, r).grid;
+        unsigned long long mirrored = 0;
+        for (unsigned c = 0; c < size; c++) { mirrored |= (row >> c & 1) << (size-1 - c); }
+
+        unsigned long long images[3] = { mirrored, ~row & full, ~mirrored & full };
+        for (int i = 0; i < 3; i++)
+        {
+            if (!open[i]) { continue; }
+            if (images[i] < row) { return false; }
+            if (images[i] > row) { open[i] = false; }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Computes the orbit of a complete grid under the symmetries of the
+ *        puzzle if it is canonical under them.
+ *
+ * Stops at the first image that is smaller than the grid, so most grids
+ * that are not canonical are rejected after a few transforms.
+ *
+ * @param grid The complete grid.
+ * @param group The symmetries of the puzzle, from getPuzzleGroup().
+ *
+ * @return The size of the orbit, or 0 if the grid is not canonical.
+ */
+static int getCanonicalOrbit(const Puzzle* grid, unsigned group)
+{
+    int fixed = 0;
+    for (int symmetry = 0; symmetry < SYMMETRIES; symmetry++)
+    {
+        if (!(group >> symmetry & 1)) { continue; }
+
+        Puzzle image = transformPuzzle(grid, symmetry);
+        int order = comparePuzzles(&image, grid);
+        if (order < 0) { return 0; }
+        if (!order) { fixed++; }
+    }
+    return __builtin_popcount(group) / fixed;
+}
+
+/**
+ * @brief Checks if a line can be placed as row k below a partial grid.
+ *
+ * Instead of calling isValid() on every node, only what the new row changes
+ * is checked: it must not repeat a row, must not complete a triplet (a run
+ * longer than RULE_MAX_RUN) with the rows above it and must not give a
+ * column more than size/2 1's or 0's, for the rules that are compiled in.
+ * Column uniqueness is checked by isValid() once the grid is complete.
+ *
+ * @param partial The grid with its first k rows filled in.
+ * @param k The index of the row to be placed.
+ * @param line The line to be placed.
+ * @param ones The number of 1's in each column so far.
+ *
+ * @return true if the line fits, false otherwise.
+ */
+static bool fitsRow(const Puzzle* partial, unsigned k, unsigned long long line, const unsigned char ones[])
+{
+    unsigned size = partial->size;
+    unsigned long long full = (1ULL << size) - 1;
+
+    for (unsigned r = 0; r < k && RULE_UNIQUE; r++)
+    {
+        if (getRow(partial, r).grid == line) { return false; }
+    }
+
+    if (k >= RULE_MAX_RUN)
+    {
+        unsigned long long same_ones = line;
+        unsigned long long same_zeros = ~line & full;
+        for (unsigned r = k - RULE_MAX_RUN; r < k; r++)
+        {
+            unsigned long long above = getRow(partial, r).grid;
+            same_ones &= above;
+            same_zeros &= ~above;
+        }
+        if (same_ones | same_zeros) { return false; }
+    }
+
+    for (unsigned c = 0; c < size && RULE_BALANCED; c++)
+    {
+        unsigned count = ones[c] + (line >> c & 1);
+        if (count > size/2 || k + 1 - count > size/2) { return false; }
+    }
+    return true;
+}
+
+/**
+ * @brief Fills in row k of a partial grid with every valid line in turn.
+ *
+ * Once enumeration->depth rows are filled in, the partial grid is passed to
+ * the callback; complete grids are checked for column uniqueness and, in
+ * canonical mode, canonicity first.
+ */
+static void enumerateRows(Enumeration* enumeration, Puzzle partial, unsigned k, const unsigned char ones[])
+{
+    unsigned size = partial.size;
+
+    if (k == enumeration->depth)
+    {
+        Solution solution = { .grid = partial, .orbit = 1 };
+        if (k == size && !isValid(&partial)) { return; }
+        if (k == size && enumeration->canonical)
+        {
+            solution.orbit = getCanonicalOrbit(&partial, enumeration->group);
+            if (!solution.orbit) { return; }
+        }
+
+        enumeration->count++;
+        if (enumeration->callback && !enumeration->callback(&solution, enumeration->context))
+        {
+            enumeration->stopped = true;
+        }
+        return;
+    }
+
+    Puzzle clues = getRow(enumeration->puzzle, k);
+    for (int j = 0; j < enumeration->line_count && !enumeration->stopped; j++)
+    {
+        unsigned long long line = enumeration->lines[j];
+        if ((line ^ clues.grid) & ~clues.actions) { continue; }
+        if (!fitsRow(&partial, k, line, ones)) { continue; }
+
+        Puzzle next = partial;
+        next.grid |= line << k * size;
+        next.actions &= ~(((1ULL << size) - 1) << k * size);
+        if (hasEdges(&next) && !meetsEdges(&next)) { continue; }
+        if (enumeration->canonical && !isCanonicalPrefix(&next, k + 1, enumeration->group)) { continue; }
+
+        unsigned char next_ones[8];
+        for (unsigned c = 0; c < size; c++) { next_ones[c] = ones[c] + (line >> c & 1); }
+        enumerateRows(enumeration, next, k + 1, next_ones);
+    }
+}
+
+/**
+ * @brief Runs an enumeration from the first rows of a start grid.
+ *
+ * Only square grids are supported, since the column counts and the
+ * canonical pruning assume as many rows as columns. The edge markers of the
+ * puzzle are copied into the partial grid and checked for every new row;
+ * canonical mode refuses them, since the symmetries do not map markers.
+ * Clues are fine: canonical mode then only uses the symmetries that map
+ * them onto themselves.
+ */
+static unsigned long long runEnumeration(const Puzzle* puzzle, const Puzzle* start, unsigned rows, unsigned depth, bool canonical, SolutionCallback callback, void* context)
+{
+    Enumeration enumeration = {
+        .puzzle = puzzle,
+        .canonical = canonical,
+        .group = 1,
+        .depth = depth,
+        .callback = callback,
+        .context = context,
+        .count = 0,
+        .stopped = false
+    };
+    if (getHeight(puzzle) != puzzle->size || (canonical && hasEdges(puzzle))) { return 0; }
+    if (canonical) { enumeration.group = getPuzzleGroup(puzzle); }
+    enumeration.line_count = getLines(puzzle->size, enumeration.lines);
+
+    Puzzle partial = {
+        .grid = 0,
+        .actions = -1,
+        .size = puzzle->size,
+        .across_equal = puzzle->across_equal,
+        .across_opposite = puzzle->across_opposite,
+        .down_equal = puzzle->down_equal,
+        .down_opposite = puzzle->down_opposite
+    };
+    unsigned char ones[8] = { 0 };
+    for (unsigned k = 0; k < rows; k++)
+    {
+        unsigned long long line = getRow(start, k).grid;
+        partial.grid |= line << k * puzzle->size;
+        partial.actions &= ~(((1ULL << puzzle->size) - 1) << k * puzzle->size);
+        for (unsigned c = 0; c < puzzle->size; c++) { ones[c] += line >> c & 1; }
+    }
+
+    enumerateRows(&enumeration, partial, rows, ones);
+    return enumeration.count;
+}
+
+/**
+ * @brief Enumerates the solutions of a puzzle.
+ *
+ * Solutions are built row by row from the table of valid lines, so they are
+ * visited in the order of comparePuzzles(). In canonical mode, only the
+ * solutions that are the smallest of their images under the symmetries
+ * that map the puzzle onto itself are visited, each with the size of its
+ * orbit under them, and prefixes that cannot lead to one are pruned. For an
+ * empty board these are all 16 symmetries and the solutions are their own
+ * canonical form (see getCanonical()); in any case the orbits add up to the
+ * number of solutions.
+ *
+ * @param puzzle The puzzle whose solutions are enumerated.
+ * @param canonical Whether to visit only canonical solutions.
+ * @param callback Called for each solution, returns false to stop. May be
+ *                 NULL to only count.
+ * @param context Passed on to the callback.
+ *
+ * @return The number of solutions visited.
+ */
+unsigned long long enumerateSolutions(const Puzzle* puzzle, bool canonical, SolutionCallback callback, void* context)
+{
+    return runEnumeration(puzzle, puzzle, 0, puzzle->size, canonical, callback, context);
+}
+
+/**
+ * @brief Enumerates the prefixes of the solutions of a puzzle.
+ *
+ * A prefix is a grid whose first rows are filled in with lines that pass
+ * the checks so far. Not every prefix has a completion, but the completions
+ * of all prefixes (see enumerateFrom()) are exactly the solutions, in the
+ * same order, which makes prefixes a deterministic way to split the search.
+ *
+ * @param puzzle The puzzle whose solutions are split.
+ * @param rows The number of rows in a prefix.
+ * @param canonical Whether to skip prefixes without canonical completions.
+ * @param callback Called for each prefix (with an orbit of 1), returns false
+ *                 to stop.
+ * @param context Passed on to the callback.
+ *
+ * @return The number of prefixes visited.
+ */
+unsigned long long enumeratePrefixes(const Puzzle* puzzle, unsigned rows, bool canonical, SolutionCallback callback, void* context)
+{
+    return runEnumeration(puzzle, puzzle, 0, rows, canonical, callback, context);
+}
+
+/**
+ * @brief Enumerates the solutions of a puzzle that start with a prefix.
+ *
+ * @param puzzle The puzzle whose solutions are enumerated.
+ * @param prefix A prefix from enumeratePrefixes().
+ * @param rows The number of rows in the prefix.
+ * @param canonical Whether to visit only canonical solutions.
+ * @param callback Called for each solution, returns false to stop.
+ * @param context Passed on to the callback.
+ *
+ * @return The number of solutions visited.
+ */
+unsigned long long enumerateFrom(const Puzzle* puzzle, const Puzzle* prefix, unsigned rows, bool canonical, SolutionCallback callback, void* context)
+{
+    return runEnumeration(puzzle, prefix, rows, puzzle->size, canonical, callback, context);
+}
@@ -0,0 +1,18 @@
+#ifndef ENUMERATE_H
+#define ENUMERATE_H
+
+#include "takuzu.h"
+
+typedef struct
+{
+    Puzzle grid;
+    int orbit;
+} Solution;
+
+typedef bool (*SolutionCallback)(const Solution* solution, void* context);
+
+unsigned long long enumerateSolutions(const Puzzle* puzzle, bool canonical, SolutionCallback callback, void* context);
+unsigned long long enumeratePrefixes(const Puzzle* puzzle, unsigned rows, bool canonical, SolutionCallback callback, void* context);
+unsigned long long enumerateFrom(const Puzzle* puzzle, const Puzzle* prefix, unsigned rows, bool canonical, SolutionCallback callback, void* context);
+
+#endif
@@ -0,0 +1,175 @@
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+#include "estimate.h"
+#include "count.h"
+
+
+typedef struct
+{
+    const Puzzle* puzzle;
+    const unsigned long long* lines;
+    int line_count;
+    double deadline;
+    unsigned long long random;
+    double sum;
+    double squares;
+    unsigned long long samples;
+} Sampler;
+
+static double getTime(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static unsigned long long getRandom(unsigned long long* state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * @brief Walks down one random path of the row search and weighs its end.
+ *
+ * This is Knuth's estimator: at each row, the lines that keep the partial
+ * grid valid according to isValid() are counted, the weight is multiplied
+ * by that count and one of them is chosen uniformly. A path that reaches a
+ * complete grid returns its weight, a dead end returns 0. The expected
+ * weight is exactly the number of solutions.
+ */
+static double walk(Sampler* sampler)
+{
+    unsigned size = sampler->puzzle->size;
+    Puzzle partial = {
+        .grid = 0,
+        .actions = -1,
+        .size = size,
+        .height = sampler->puzzle->height,
+        .across_equal = sampler->puzzle->across_equal,
+        .across_opposite = sampler->puzzle->across_opposite,
+        .down_equal = sampler->puzzle->down_equal,
+        .down_opposite = sampler->puzzle->down_opposite
+    };
+    double weight = 1;
+
+    for (unsigned k = 0; k < getHeight(&partial); k++)
+    {
+        Puzzle clues = getRow(sampler->puzzle, k);
+        Puzzle children[MAX_LINES];
+        int count = 0;
+
+        for (int j = 0; j < sampler->line_count; j++)
+        {
+            if ((sampler->lines[j] ^ clues.grid) & ~clues.actions) { continue; }
+
+            Puzzle child = partial;
+            child.grid |= sampler->lines[j] << k * size;
+            child.actions &= ~(((1ULL << size) - 1) << k * size);
+            if (isValid(&child)) { children[count++] = child; }
+        }
+
+        if (!count) { return 0; }
+        weight *= count;
+        partial = children[getRandom(&sampler->random) % count];
+    }
+    return weight;
+}
+
+/**
+ * @brief Samples paths until the deadline.
+ *
+ * The samplers of all threads sit next to each other in an array, so each
+ * thread works on a copy on its own stack, random state and totals
+ * included, and stores it back once at the end instead of writing to
+ * shared cache lines on every walk.
+ */
+static void* runSampler(void* argument)
+{
+    Sampler* shared = argument;
+    Sampler sampler = *shared;
+    do
+    {
+        for (int i = 0; i < 64; i++)
+        {
+            double weight = walk(&sampler);
+            sampler.sum += weight;
+            sampler.squares += weight * weight;
+            sampler.samples++;
+        }
+    } while (getTime() < sampler.deadline);
+
+    *shared = sampler;
+    return NULL;
+}
+
+/**
+ * @brief Estimates the number of solutions of a puzzle by random sampling.
+ *
+ * Each thread walks random paths of the row search (see walk()) until the
+ * time budget is used up. The mean weight over all paths is an unbiased
+ * estimate of the number of solutions, and its standard error gives an
+ * approximate 95% confidence interval. Useful where exact counting with
+ * countMarginals() is too slow, e.g. for puzzles with many solutions.
+ *
+ * @param puzzle The puzzle whose solutions are estimated.
+ * @param seconds The time budget.
+ * @param threads The number of threads to sample with, at most 64.
+ * @param seed The seed of the random paths.
+ *
+ * @return The estimate with its confidence interval, clamped at 0 below.
+ */
+Estimate estimateSolutions(const Puzzle* puzzle, double seconds, int threads, unsigned long long seed)
+{
+    unsigned long long lines[MAX_LINES];
+    int line_count = getLines(puzzle->size, lines);
+    Sampler samplers[64];
+    pthread_t ids[64];
+    double deadline = getTime() + seconds;
+
+    if (threads < 1) { threads = 1; }
+    if (threads > 64) { threads = 64; }
+
+    for (int i = 0; i < threads; i++)
+    {
+        samplers[i] = (Sampler) {
+            .puzzle = puzzle,
+            .lines = lines,
+            .line_count = line_count,
+            .deadline = deadline,
+            .random = (seed + i + 1) * 0x9E3779B97F4A7C15ULL | 1,
+            .sum = 0,
+            .squares = 0,
+            .samples = 0
+        };
+    }
+
+    int started = 1;
+    while (started < threads && !pthread_create(&ids[started], NULL, runSampler, &samplers[started])) { started++; }
+    runSampler(&samplers[0]);
+    for (int i = 1; i < started; i++) { pthread_join(ids[i], NULL); }
+
+    double sum = 0;
+    double squares = 0;
+    unsigned long long samples = 0;
+    for (int i = 0; i < started; i++)
+    {
+        sum += samplers[i].sum;
+        squares += samplers[i].squares;
+        samples += samplers[i].samples;
+    }
+
+    double mean = sum / samples;
+    double variance = samples > 1 ? (squares - samples * mean * mean) / (samples - 1) : 0;
+    double error = 1.96 * sqrt(variance > 0 ? variance / samples : 0);
+
+    return (Estimate) {
+        .count = mean,
+        .low = mean > error ? mean - error : 0,
+        .high = mean + error,
+        .samples = samples
+    };
+}
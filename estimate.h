@@ -0,0 +1,16 @@
+#ifndef ESTIMATE_H
+#define ESTIMATE_H
+
+#include "takuzu.h"
+
+typedef struct
+{
+    double count;
+    double low;
+    double high;
+    unsigned long long samples;
+} Estimate;
+
+Estimate estimateSolutions(const Puzzle* puzzle, double seconds, int threads, unsigned long long seed);
+
+#endif
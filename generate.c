@@ -0,0 +1,523 @@
+#include <pthread.h>
+#include <time.h>
+#include "generate.h"
+#include "search.h"
+#include "count.h"
+
+
+/**
+ * @brief Searches a propagated puzzle for a solution, see hasOtherSolution().
+ */
+static bool searchOther(Puzzle puzzle, const Puzzle* solution)
+{
+    if (!getEmpty(&puzzle)) { return true; }
+
+    int i = 0;
+    while (!(puzzle.actions & 1ULL << i)) { i++; }
+
+    Puzzle same = puzzle;
+    same.actions ^= 1ULL << i;
+    same.grid |= solution->grid & 1ULL << i;
+    if (hasOtherSolution(same, solution)) { return true; }
+
+    same.grid ^= 1ULL << i;
+    return hasOtherSolution(same, solution);
+}
+
+/**
+ * @brief Searches for a solution of a puzzle other than the known one.
+ *
+ * The puzzle must already differ from the known solution in at least one
+ * filled in cell, so any solution found is another one. The search branches
+ * on the first empty cell and tries the known solution's value first, since
+ * a second solution usually agrees with the first in most cells.
+ *
+ * @param puzzle The puzzle to be searched.
+ * @param solution The known solution, used to order the values.
+ *
+ * @return true if the puzzle has a solution, false otherwise.
+ */
+bool hasOtherSolution(Puzzle puzzle, const Puzzle* solution)
+{
+    return propagate(&puzzle) && searchOther(puzzle, solution);
+}
+
+/**
+ * @brief Checks if a puzzle stays unique when one of its clues is removed.
+ *
+ * Every solution of the puzzle without the clue that agrees with the clue is
+ * a solution of the puzzle itself, i.e. the known solution. So instead of
+ * counting the solutions of the puzzle without the clue from scratch, only
+ * the region that disagrees with the removed clue has to be searched: the
+ * clue is flipped and the puzzle stays unique iff that has no solution.
+ *
+ * @param puzzle A puzzle with a unique solution.
+ * @param solution The solution of the puzzle.
+ * @param cell The index of the clue to be removed, as a bit in the grid.
+ *
+ * @return true if the puzzle without the clue still has a unique solution.
+ */
+bool isUniqueWithout(const Puzzle* puzzle, const Puzzle* solution, int cell)
+{
+    Puzzle flipped = *puzzle;
+    flipped.grid ^= 1ULL << cell;
+    return !hasOtherSolution(flipped, solution);
+}
+
+/**
+ * @brief Checks if a puzzle stays unique without a clue, on top of a stack
+ *        of assumptions that holds the clues that stay.
+ *
+ * Works like isUniqueWithout(), but only the clues that vary, and the
+ * flipped clue, are pushed onto the propagated state of the clues that stay
+ * and retracted afterwards, so that state is shared by all queries.
+ *
+ * @param assumptions The clues of the puzzle that stay, propagated.
+ * @param puzzle A puzzle with a unique solution.
+ * @param solution The solution of the puzzle.
+ * @param rest The other clues of the puzzle that are not on the stack.
+ * @param cell The index of the clue to be removed, as a bit in the grid.
+ *
+ * @return true if the puzzle without the clue still has a unique solution.
+ */
+static bool isUniqueUnder(Assumptions* assumptions, const Puzzle* puzzle, const Puzzle* solution, unsigned long long rest, int cell)
+{
+    if (assumptions->depth == MAX_ASSUMPTIONS) { return isUniqueWithout(puzzle, solution, cell); }
+
+    Puzzle flipped = *puzzle;
+    flipped.grid ^= 1ULL << cell;
+    bool unique = !assumeClues(assumptions, &flipped, rest | 1ULL << cell) || !searchOther(*getAssumed(assumptions), solution);
+    retract(assumptions);
+    return unique;
+}
+
+/**
+ * @brief Returns a puzzle with only some of its clues.
+ */
+static Puzzle keepClues(const Puzzle* puzzle, unsigned long long clues)
+{
+    Puzzle kept = *puzzle;
+    unsigned long long dropped = ~clues & ~puzzle->actions;
+    kept.actions |= dropped;
+    kept.grid &= ~dropped;
+    return kept;
+}
+
+/**
+ * @brief Removes clues from a puzzle as long as it stays unique.
+ *
+ * The clues are tried in the given order and each one is removed if the
+ * puzzle stays unique without it. A clue that has to stay would have to stay
+ * after any later removal as well, so each clue is checked only once and the
+ * result is a minimal puzzle, i.e. no single clue can be removed. The clues
+ * that stay are assumed one by one on a shared stack, see isUniqueUnder().
+ *
+ * @param puzzle A puzzle with a unique solution.
+ * @param solution The solution of the puzzle.
+ * @param cells The indices of the clues to try, in order.
+ * @param count The number of indices.
+ *
+ * @return The puzzle with the redundant clues removed.
+ */
+Puzzle removeClues(const Puzzle* puzzle, const Puzzle* solution, const int cells[], int count)
+{
+    Puzzle reduced = *puzzle;
+    unsigned long long pending = 0;
+    for (int i = 0; i < count; i++) { pending |= 1ULL << cells[i] & ~getEmpty(puzzle); }
+
+    Assumptions assumptions;
+    Puzzle base = keepClues(puzzle, ~pending);
+    initAssumptions(&assumptions, &base);
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!(pending & 1ULL << cells[i])) { continue; }
+        pending &= ~(1ULL << cells[i]);
+
+        if (isUniqueUnder(&assumptions, &reduced, solution, pending, cells[i]))
+        {
+            reduced.actions |= 1ULL << cells[i];
+            reduced.grid &= ~(1ULL << cells[i]);
+        }
+        else
+        {
+            assumeClues(&assumptions, &reduced, 1ULL << cells[i]);
+        }
+    }
+    return reduced;
+}
+
+typedef struct
+{
+    const Puzzle* solution;
+    unsigned long long max_nodes;
+    unsigned long long nodes;
+    Puzzle best;
+    int best_clues;
+    Assumptions assumptions;
+} Bound;
+
+/**
+ * @brief Searches the clue subsets below a unique puzzle for the smallest.
+ *
+ * Clues are removed in increasing order of their index, so each subset is
+ * visited once. A clue that cannot be removed now cannot be removed after
+ * other removals either, so the children of a node only consider the
+ * removable clues of their parent, and removing all of them is a lower
+ * bound on the clues below the node. Subtrees that cannot beat the best
+ * puzzle found so far are cut off.
+ *
+ * The clues outside the pool stay in the whole subtree, so they are kept
+ * propagated on bound->assumptions and each child pushes the clues that
+ * leave the pool on the way down, see isUniqueUnder().
+ *
+ * @param bound The state of the search.
+ * @param puzzle A unique puzzle.
+ * @param clues The number of clues of the puzzle.
+ * @param pool The clues that may be removed below this node.
+ * @param pool_count The number of clues in the pool.
+ */
+static void branch(Bound* bound, const Puzzle* puzzle, int clues, const int pool[], int pool_count)
+{
+    int candidates[64];
+    int count = 0;
+    unsigned long long rest = 0;
+
+    if (bound->nodes++ >= bound->max_nodes) { return; }
+    if (clues < bound->best_clues)
+    {
+        bound->best = *puzzle;
+        bound->best_clues = clues;
+    }
+
+    for (int i = 0; i < pool_count; i++) { rest |= 1ULL << pool[i]; }
+    for (int i = 0; i < pool_count; i++)
+    {
+        if (isUniqueUnder(&bound->assumptions, puzzle, bound->solution, rest & ~(1ULL << pool[i]), pool[i]))
+        {
+            candidates[count++] = pool[i];
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (clues - (count - i) >= bound->best_clues) { return; }
+
+        unsigned long long staying = rest;
+        for (int j = i; j < count; j++) { staying &= ~(1ULL << candidates[j]); }
+
+        Puzzle reduced = *puzzle;
+        reduced.actions |= 1ULL << candidates[i];
+        reduced.grid &= ~(1ULL << candidates[i]);
+        assumeClues(&bound->assumptions, puzzle, staying);
+        branch(bound, &reduced, clues - 1, candidates + i + 1, count - i - 1);
+        retract(&bound->assumptions);
+    }
+}
+
+/**
+ * @brief Finds a puzzle with as few clues as possible for a solution grid.
+ *
+ * A greedy removeClues() pass gives the first bound, after which branch()
+ * searches all clue subsets that can still beat it. The search is cut off
+ * after max_nodes nodes, in which case the best puzzle found so far is
+ * returned.
+ *
+ * @param solution A complete, valid grid.
+ * @param max_nodes The maximum number of nodes to search.
+ * @param exact Receives whether the search completed, i.e. whether no
+ *              puzzle with fewer clues exists. May be NULL.
+ *
+ * @return A unique puzzle whose solution is the grid.
+ */
+Puzzle findMinimalPuzzle(const Puzzle* solution, unsigned long long max_nodes, bool* exact)
+{
+    int cells[64];
+    int cell_count = solution->size*getHeight(solution);
+    for (int i = 0; i < cell_count; i++) { cells[i] = i; }
+
+    Bound bound = {
+        .solution = solution,
+        .max_nodes = max_nodes,
+        .nodes = 0,
+        .best = removeClues(solution, solution, cells, cell_count)
+    };
+    bound.best_clues = countClues(&bound.best);
+
+    Puzzle grid = *solution;
+    grid.actions = 0;
+    Puzzle empty = keepClues(&grid, 0);
+    initAssumptions(&bound.assumptions, &empty);
+    branch(&bound, &grid, cell_count, cells, cell_count);
+
+    if (exact) { *exact = bound.nodes < max_nodes; }
+    return bound.best;
+}
+
+typedef struct
+{
+    const Puzzle* grids;
+    Puzzle* results;
+    bool* exact;
+    int count;
+    int next;
+    int done;
+    int best;
+    unsigned long long max_nodes;
+    ProgressCallback progress;
+    void* context;
+    pthread_mutex_t lock;
+} Batch;
+
+static void* runBatch(void* argument)
+{
+    Batch* batch = argument;
+    while (true)
+    {
+        pthread_mutex_lock(&batch->lock);
+        int i = batch->next++;
+        pthread_mutex_unlock(&batch->lock);
+        if (i >= batch->count) { return NULL; }
+
+        bool exact;
+        Puzzle result = findMinimalPuzzle(&batch->grids[i], batch->max_nodes, &exact);
+
+        pthread_mutex_lock(&batch->lock);
+        batch->results[i] = result;
+        if (batch->exact) { batch->exact[i] = exact; }
+        if (batch->best < 0 || countClues(&result) < countClues(&batch->results[batch->best])) { batch->best = i; }
+        batch->done++;
+        if (batch->progress)
+        {
+            batch->progress(batch->done, batch->count, &batch->results[batch->best], batch->context);
+        }
+        pthread_mutex_unlock(&batch->lock);
+    }
+}
+
+/**
+ * @brief Runs findMinimalPuzzle() over many solution grids in parallel.
+ *
+ * The grids are handed out one at a time to the threads, so slow grids do
+ * not hold up the others. After each grid, the progress callback is called
+ * with the number of grids done and the puzzle with the fewest clues so
+ * far; calls are serialised, so the callback does not need to lock.
+ *
+ * @param grids The solution grids.
+ * @param results Receives the puzzle found for each grid.
+ * @param exact Receives whether each search completed, may be NULL.
+ * @param count The number of grids.
+ * @param threads The number of threads to search with, at most 64.
+ * @param max_nodes The maximum number of nodes to search per grid.
+ * @param progress Called after each grid, may be NULL.
+ * @param context Passed on to the progress callback.
+ */
+void findMinimalPuzzles(const Puzzle grids[], Puzzle results[], bool exact[], int count, int threads, unsigned long long max_nodes, ProgressCallback progress, void* context)
+{
+    Batch batch = {
+        .grids = grids,
+        .results = results,
+        .exact = exact,
+        .count = count,
+        .next = 0,
+        .done = 0,
+        .best = -1,
+        .max_nodes = max_nodes,
+        .progress = progress,
+        .context = context
+    };
+    pthread_t ids[64];
+
+    if (threads < 1) { threads = 1; }
+    if (threads > 64) { threads = 64; }
+
+    pthread_mutex_init(&batch.lock, NULL);
+    int started = 1;
+    while (started < threads && !pthread_create(&ids[started], NULL, runBatch, &batch)) { started++; }
+    runBatch(&batch);
+    for (int i = 1; i < started; i++) { pthread_join(ids[i], NULL); }
+    pthread_mutex_destroy(&batch.lock);
+}
+
+/**
+ * @brief Checks a puzzle after a cell was filled in, with the rules of a
+ *        grade.
+ *
+ * Grade 1 only knows the triplet rule. From grade 2 on the whole puzzle is
+ * checked with isValid(), which adds the balance and uniqueness rules.
+ */
+static bool allows(const Puzzle* puzzle, int cell, int grade)
+{
+    if (grade >= 2) { return isValid(puzzle); }
+
+    Puzzle row = getRow(puzzle, cell / puzzle->size);
+    Puzzle col = getCol(puzzle, cell % puzzle->size);
+    return !hasTriplets(&row) && !hasTriplets(&col);
+}
+
+/**
+ * @brief Fills in the cells forced by the rules of a grade.
+ *
+ * Like propagate(), a cell is forced if only one of its values is allowed.
+ * Grade 3 also looks one step ahead: a value is ruled out if propagate()
+ * finds a contradiction after filling it in.
+ *
+ * @return false if the puzzle turns out to be invalid, true otherwise.
+ */
+static bool propagateGrade(Puzzle* puzzle, int grade)
+{
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int i = 0; i < puzzle->size*getHeight(puzzle); i++)
+        {
+            if (!(puzzle->actions & 1ULL << i)) { continue; }
+
+            Puzzle zero = *puzzle;
+            zero.actions ^= 1ULL << i;
+            Puzzle one = zero;
+            one.grid |= 1ULL << i;
+
+            bool can_zero = allows(&zero, i, grade);
+            bool can_one = allows(&one, i, grade);
+            if (grade >= 3)
+            {
+                Puzzle ahead = zero;
+                can_zero = can_zero && propagate(&ahead);
+                ahead = one;
+                can_one = can_one && propagate(&ahead);
+            }
+            if (!can_zero && !can_one) { return false; }
+
+            if (!can_zero) { *puzzle = one; changed = true; }
+            else if (!can_one) { *puzzle = zero; changed = true; }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Grades a puzzle by the rules needed to solve it without guessing.
+ *
+ * 1: the triplet rule suffices.
+ * 2: the balance and uniqueness rules are needed as well.
+ * 3: looking one step ahead is needed as well.
+ * 4: anything harder, i.e. the puzzle has to be searched.
+ *
+ * @param puzzle The puzzle to be graded, with a unique solution.
+ *
+ * @return The grade of the puzzle.
+ */
+int gradePuzzle(const Puzzle* puzzle)
+{
+    for (int grade = 1; grade < MAX_GRADE; grade++)
+    {
+        Puzzle solved = *puzzle;
+        if (propagateGrade(&solved, grade) && !getEmpty(&solved)) { return grade; }
+    }
+    return MAX_GRADE;
+}
+
+static unsigned long long getRandom(unsigned long long* state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * @brief Draws a uniformly random number below a bound.
+ *
+ * Taking a 64-bit draw modulo the bound would favour the low remainders
+ * when the bound does not divide 2^64, so draws below 2^64 mod bound are
+ * rejected and redrawn. That leaves a multiple of bound equally likely
+ * values, and a draw is rejected with probability below bound / 2^64.
+ *
+ * @param random The state of the random generator, non-zero.
+ * @param bound The number of possible results, at least 1.
+ *
+ * @return A number from 0 to bound - 1.
+ */
+unsigned long long drawBelow(unsigned long long* random, unsigned long long bound)
+{
+    unsigned long long threshold = -bound % bound;
+    unsigned long long draw = getRandom(random);
+    while (draw < threshold) { draw = getRandom(random); }
+    return draw % bound;
+}
+
+/**
+ * @brief Generates a unique puzzle of a given grade.
+ *
+ * Each attempt draws a uniformly random solution grid and removes its clues
+ * in random order. A removal is kept only if the puzzle stays unique and its
+ * grade does not exceed the target, so the attempt climbs towards the
+ * target and stops at a puzzle where every further removal breaks
+ * uniqueness or overshoots. If the attempt ends below the target it is
+ * rejected and a new grid is drawn.
+ *
+ * @param ranking The ranking of the grids of the wanted size.
+ * @param grade The target grade, 1 to MAX_GRADE.
+ * @param random The state of the random generator, non-zero.
+ * @param max_attempts The number of attempts after which to give up.
+ * @param puzzle Receives the generated puzzle.
+ * @param stats Accumulates the attempts, acceptances and time spent. May be
+ *              NULL.
+ *
+ * @return true if a puzzle was generated, false if all attempts failed.
+ */
+bool generatePuzzle(const Ranking* ranking, int grade, unsigned long long* random, int max_attempts, Puzzle* puzzle, GeneratorStats* stats)
+{
+    struct timespec start;
+    struct timespec end;
+    bool generated = false;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int attempt = 0; attempt < max_attempts && !generated; attempt++)
+    {
+        Puzzle solution;
+        unrankGrid(ranking, drawBelow(random, countGrids(ranking)), &solution);
+
+        int cells[64];
+        int cell_count = solution.size*solution.size;
+        for (int i = 0; i < cell_count; i++) { cells[i] = i; }
+        for (int i = cell_count - 1; i > 0; i--)
+        {
+            int j = drawBelow(random, i + 1);
+            int cell = cells[i];
+            cells[i] = cells[j];
+            cells[j] = cell;
+        }
+
+        Puzzle current = solution;
+        int current_grade = 1;
+        for (int i = 0; i < cell_count; i++)
+        {
+            if (!isUniqueWithout(&current, &solution, cells[i])) { continue; }
+
+            Puzzle reduced = current;
+            reduced.actions |= 1ULL << cells[i];
+            reduced.grid &= ~(1ULL << cells[i]);
+
+            int reduced_grade = gradePuzzle(&reduced);
+            if (reduced_grade > grade) { continue; }
+
+            current = reduced;
+            current_grade = reduced_grade;
+        }
+
+        if (stats) { stats->attempts++; }
+        if (current_grade == grade)
+        {
+            *puzzle = current;
+            generated = true;
+            if (stats) { stats->accepted++; }
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (stats) { stats->seconds += end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9; }
+    return generated;
+}
@@ -0,0 +1,27 @@
+#ifndef GENERATE_H
+#define GENERATE_H
+
+#include "takuzu.h"
+#include "count.h"
+
+#define MAX_GRADE 4
+
+typedef struct
+{
+    unsigned long long attempts;
+    unsigned long long accepted;
+    double seconds;
+} GeneratorStats;
+
+typedef void (*ProgressCallback)(int done, int total, const Puzzle* best, void* context);
+
+bool hasOtherSolution(Puzzle puzzle, const Puzzle* solution);
+bool isUniqueWithout(const Puzzle* puzzle, const Puzzle* solution, int cell);
+Puzzle removeClues(const Puzzle* puzzle, const Puzzle* solution, const int cells[], int count);
+Puzzle findMinimalPuzzle(const Puzzle* solution, unsigned long long max_nodes, bool* exact);
+void findMinimalPuzzles(const Puzzle grids[], Puzzle results[], bool exact[], int count, int threads, unsigned long long max_nodes, ProgressCallback progress, void* context);
+int gradePuzzle(const Puzzle* puzzle);
+unsigned long long drawBelow(unsigned long long* random, unsigned long long bound);
+bool generatePuzzle(const Ranking* ranking, int grade, unsigned long long* random, int max_attempts, Puzzle* puzzle, GeneratorStats* stats);
+
+#endif
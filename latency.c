@@ -0,0 +1,256 @@
+#include <stdlib.h>
+#include "latency.h"
+#include "batch.h"
+
+#define SUB_BITS 5
+#define SUB_BUCKETS (1 << SUB_BITS)
+#define MAX_EXPONENT 39
+#define BUCKETS ((MAX_EXPONENT - SUB_BITS + 2) * SUB_BUCKETS)
+#define DIMENSIONS 7
+#define SLOTS (DIMENSIONS * DIMENSIONS)
+
+
+/**
+ * Latencies are counted in log-linear buckets, like HdrHistogram: below
+ * SUB_BUCKETS nanoseconds every value has its own bucket, above that each
+ * power of two is split into SUB_BUCKETS buckets, so a bucket is at most
+ * 1/SUB_BUCKETS (about 3%) wider than its values, up to 2^(MAX_EXPONENT+1)
+ * nanoseconds (about 18 minutes).
+ *
+ * Every thread has its own histograms, one per size of puzzle, allocated
+ * when the thread first sees that size. Only the thread writes to them, so
+ * recording takes no lock or atomic read-modify-write; the counts are
+ * stored with relaxed atomics so that the histograms can be read while
+ * threads are still recording, e.g. by a long-running mode reporting its
+ * percentiles periodically. Readers merge the histograms of all threads.
+ */
+typedef struct
+{
+    unsigned long long counts[LATENCY_OUTCOMES][BUCKETS];
+    unsigned long long max[LATENCY_OUTCOMES];
+} Histogram;
+
+struct Latency
+{
+    Histogram* histograms[LATENCY_THREADS][SLOTS];
+};
+
+static const char* outcome_names[LATENCY_OUTCOMES] = {
+    [BATCH_UNIQUE] = "unique",
+    [BATCH_MULTIPLE] = "multiple",
+    [BATCH_NO_SOLUTION] = "unsat",
+    [BATCH_INVALID] = "invalid"
+};
+
+/**
+ * @brief Maps the dimensions of a puzzle to the number of its histogram.
+ *
+ * @return The slot, or -1 if no puzzle has these dimensions.
+ */
+static int getSlot(unsigned size, unsigned height)
+{
+    if (size < 4 || height < 4 || size % 2 || height % 2 || size * height > 64) { return -1; }
+    return (size/2 - 2) * DIMENSIONS + height/2 - 2;
+}
+
+static int getBucket(unsigned long long nanoseconds)
+{
+    if (nanoseconds < SUB_BUCKETS) { return (int)nanoseconds; }
+
+    int exponent = 63 - __builtin_clzll(nanoseconds);
+    if (exponent > MAX_EXPONENT) { return BUCKETS - 1; }
+    return (exponent - SUB_BITS + 1) * SUB_BUCKETS + (int)(nanoseconds >> (exponent - SUB_BITS) & (SUB_BUCKETS - 1));
+}
+
+/**
+ * @brief Returns the highest latency that falls into a bucket. The last
+ *        bucket also takes every longer latency, so it has no limit.
+ */
+static unsigned long long getBucketLimit(int bucket)
+{
+    if (bucket < SUB_BUCKETS) { return bucket; }
+    if (bucket == BUCKETS - 1) { return -1ULL; }
+
+    int shift = bucket / SUB_BUCKETS - 1;
+    unsigned long long low = (unsigned long long)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+    return low + (1ULL << shift) - 1;
+}
+
+/**
+ * @brief Creates an empty set of latency histograms.
+ *
+ * @return The histograms, or NULL if out of memory.
+ */
+Latency* createLatency(void)
+{
+    return calloc(1, sizeof(Latency));
+}
+
+void freeLatency(Latency* latency)
+{
+    if (!latency) { return; }
+    for (int thread = 0; thread < LATENCY_THREADS; thread++)
+    {
+        for (int slot = 0; slot < SLOTS; slot++) { free(latency->histograms[thread][slot]); }
+    }
+    free(latency);
+}
+
+/**
+ * @brief Records how long one puzzle took.
+ *
+ * Each thread has to pass its own number, and no two threads running at
+ * the same time may pass the same one. A sample is dropped if the puzzle
+ * has no valid dimensions or its histogram cannot be allocated.
+ *
+ * @param latency The histograms.
+ * @param thread The number of the calling thread, below LATENCY_THREADS.
+ * @param size The width of the puzzle.
+ * @param height The height of the puzzle.
+ * @param outcome The BatchStatus of the puzzle.
+ * @param nanoseconds The time it took.
+ */
+void recordLatency(Latency* latency, int thread, unsigned size, unsigned height, int outcome, unsigned long long nanoseconds)
+{
+    int slot = getSlot(size, height);
+    if (slot < 0 || thread < 0 || thread >= LATENCY_THREADS || outcome < 0 || outcome >= LATENCY_OUTCOMES) { return; }
+
+    Histogram* histogram = latency->histograms[thread][slot];
+    if (!histogram)
+    {
+        histogram = calloc(1, sizeof(Histogram));
+        if (!histogram) { return; }
+        __atomic_store_n(&latency->histograms[thread][slot], histogram, __ATOMIC_RELEASE);
+    }
+
+    unsigned long long* count = &histogram->counts[outcome][getBucket(nanoseconds)];
+    __atomic_store_n(count, *count + 1, __ATOMIC_RELAXED);
+    if (nanoseconds > histogram->max[outcome]) { __atomic_store_n(&histogram->max[outcome], nanoseconds, __ATOMIC_RELAXED); }
+}
+
+/**
+ * @brief Adds up the histograms of all threads for one size and outcome.
+ *
+ * @param counts Receives the merged count per bucket.
+ *
+ * @return The highest latency recorded, 0 if there are none.
+ */
+static unsigned long long mergeHistograms(const Latency* latency, int slot, int outcome, unsigned long long counts[])
+{
+    unsigned long long max = 0;
+    for (int bucket = 0; bucket < BUCKETS; bucket++) { counts[bucket] = 0; }
+
+    for (int thread = 0; thread < LATENCY_THREADS; thread++)
+    {
+        Histogram* histogram = __atomic_load_n(&latency->histograms[thread][slot], __ATOMIC_ACQUIRE);
+        if (!histogram) { continue; }
+
+        for (int bucket = 0; bucket < BUCKETS; bucket++)
+        {
+            counts[bucket] += __atomic_load_n(&histogram->counts[outcome][bucket], __ATOMIC_RELAXED);
+        }
+        unsigned long long thread_max = __atomic_load_n(&histogram->max[outcome], __ATOMIC_RELAXED);
+        if (thread_max > max) { max = thread_max; }
+    }
+    return max;
+}
+
+/**
+ * @brief Finds a percentile in merged counts, see getLatencyPercentile().
+ */
+static unsigned long long findPercentile(const unsigned long long counts[], unsigned long long total,
+                                         unsigned long long max, double percentile)
+{
+    if (!total) { return 0; }
+
+    unsigned long long rank = (unsigned long long)(percentile / 100 * total + 0.5);
+    if (rank < 1) { rank = 1; }
+    if (rank > total) { rank = total; }
+
+    unsigned long long seen = 0;
+    for (int bucket = 0; bucket < BUCKETS; bucket++)
+    {
+        seen += counts[bucket];
+        if (seen >= rank)
+        {
+            unsigned long long limit = getBucketLimit(bucket);
+            return limit < max ? limit : max;
+        }
+    }
+    return max;
+}
+
+/**
+ * @brief Counts the latencies recorded for a size and outcome.
+ */
+unsigned long long countLatency(const Latency* latency, unsigned size, unsigned height, int outcome)
+{
+    int slot = getSlot(size, height);
+    if (slot < 0 || outcome < 0 || outcome >= LATENCY_OUTCOMES) { return 0; }
+
+    unsigned long long counts[BUCKETS];
+    mergeHistograms(latency, slot, outcome, counts);
+
+    unsigned long long total = 0;
+    for (int bucket = 0; bucket < BUCKETS; bucket++) { total += counts[bucket]; }
+    return total;
+}
+
+/**
+ * @brief Returns a percentile of the latencies for a size and outcome.
+ *
+ * The result is the highest latency of the bucket the percentile falls in,
+ * so it overestimates by at most about 3%, but never exceeds the highest
+ * latency recorded. Can be called while threads are still recording.
+ *
+ * @param latency The histograms.
+ * @param size The width of the puzzles.
+ * @param height The height of the puzzles.
+ * @param outcome The BatchStatus of the puzzles.
+ * @param percentile The percentile, from 0 to 100.
+ *
+ * @return The latency in nanoseconds, 0 if none are recorded.
+ */
+unsigned long long getLatencyPercentile(const Latency* latency, unsigned size, unsigned height, int outcome, double percentile)
+{
+    int slot = getSlot(size, height);
+    if (slot < 0 || outcome < 0 || outcome >= LATENCY_OUTCOMES) { return 0; }
+
+    unsigned long long counts[BUCKETS];
+    unsigned long long max = mergeHistograms(latency, slot, outcome, counts);
+
+    unsigned long long total = 0;
+    for (int bucket = 0; bucket < BUCKETS; bucket++) { total += counts[bucket]; }
+    return findPercentile(counts, total, max, percentile);
+}
+
+/**
+ * @brief Prints a table of latency percentiles, in microseconds, with a row
+ *        for every size and outcome that has any.
+ */
+void printLatency(const Latency* latency, FILE* output)
+{
+    const double percentiles[] = { 50, 90, 99, 99.9 };
+    unsigned long long counts[BUCKETS];
+
+    fprintf(output, "%-16s %10s %10s %10s %10s %10s %10s\n", "Latency (us)", "count", "p50", "p90", "p99", "p99.9", "max");
+    for (int slot = 0; slot < SLOTS; slot++)
+    {
+        for (int outcome = 0; outcome < LATENCY_OUTCOMES; outcome++)
+        {
+            unsigned long long max = mergeHistograms(latency, slot, outcome, counts);
+            unsigned long long total = 0;
+            for (int bucket = 0; bucket < BUCKETS; bucket++) { total += counts[bucket]; }
+            if (!total) { continue; }
+
+            char label[32];
+            snprintf(label, sizeof(label), "%dx%d %s", (slot / DIMENSIONS + 2) * 2, (slot % DIMENSIONS + 2) * 2, outcome_names[outcome]);
+            fprintf(output, "%-16s %10llu", label, total);
+            for (int i = 0; i < 4; i++)
+            {
+                fprintf(output, " %10.1f", findPercentile(counts, total, max, percentiles[i]) / 1e3);
+            }
+            fprintf(output, " %10.1f\n", max / 1e3);
+        }
+    }
+}
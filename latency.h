@@ -0,0 +1,19 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+#include "takuzu.h"
+
+#define LATENCY_THREADS 64
+#define LATENCY_OUTCOMES 4
+
+typedef struct Latency Latency;
+
+Latency* createLatency(void);
+void freeLatency(Latency* latency);
+void recordLatency(Latency* latency, int thread, unsigned size, unsigned height, int outcome, unsigned long long nanoseconds);
+unsigned long long countLatency(const Latency* latency, unsigned size, unsigned height, int outcome);
+unsigned long long getLatencyPercentile(const Latency* latency, unsigned size, unsigned height, int outcome, double percentile);
+void printLatency(const Latency* latency, FILE* output);
+
+#endif
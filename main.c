@@ -1,14 +1,849 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include "takuzu.h"
+#include "batch.h"
+#include "catalog.h"
+#include "count.h"
+#include "counters.h"
+#include "dedup.h"
+#include "dispatch.h"
+#include "generate.h"
+#include "near.h"
+#include "search.h"
+#include "shard.h"
+#include "store.h"
+#include "trace.h"
 
 
+static Counters counters;
+static bool counting = false;
+
+/**
+ * @brief Switches the hardware counters to another phase, if --counters is
+ *        given.
+ */
+static void measurePhase(Phase phase)
+{
+    if (counting) { enterPhase(&counters, phase); }
+}
+
+/**
+ * @brief Prints the hardware counters per phase when the program exits.
+ *
+ * Phases are only marked while solving a single puzzle and in --batch;
+ * other commands report their whole run as the parse phase.
+ */
+static void reportCounters(void)
+{
+    stopCounters(&counters);
+    printCounters(&counters, stdout);
+    closeCounters(&counters);
+}
+
+/**
+ * @brief Solves a puzzle like solve(), with a phase per step.
+ *
+ * The puzzle is propagated, then searched for its first solution, and then
+ * printed, so the counters separate the three.
+ *
+ * The solution printed is the one solve() prints. solve() tries 0 before 1,
+ * cell by cell, and only gives up on grids that cannot be completed, so it
+ * finds the first solution in that order. Propagation only fills in cells
+ * that take the same value in every solution, and countSolutions() then
+ * branches in the same order, so it finds the same solution.
+ *
+ * @return true if a solution is found, false otherwise.
+ */
+static bool solveMeasured(const Puzzle* puzzle)
+{
+    Puzzle root = *puzzle;
+    Puzzle solution = { 0 };
+
+    measurePhase(PHASE_PROPAGATE);
+    bool consistent = propagate(&root);
+    measurePhase(PHASE_SEARCH);
+    bool solved = consistent && countSolutions(root, 1, &solution);
+    measurePhase(PHASE_OUTPUT);
+    if (solved) { printPuzzle(&solution); }
+    return solved;
+}
+
+/**
+ * @brief Prints a minimal subset of the puzzle's clues that has no solution.
+ *
+ * @param puzzle A puzzle without solutions.
+ */
+static void printConflict(const Puzzle* puzzle)
+{
+    bool exact;
+    Puzzle conflict = getConflict(puzzle, CONFLICT_NODES, &exact);
+    printf("These clues cannot be satisfied together:\n");
+    printPuzzle(&conflict);
+    if (!exact) { printf("The search was cut short, so some of them may not be needed.\n"); }
+}
+
+/**
+ * @brief Runs one shard of the enumeration of a puzzle's solutions.
+ *
+ * Usage: --enumerate [puzzleString] [shard] [shards] [output] [--canonical]
+ * The progress is recorded in output.checkpoint; running the same command
+ * again resumes where it left off.
+ */
+static int enumerate(int argc, char** argv)
+{
+    if (argc != 6 && !(argc == 7 && !strcmp(argv[6], "--canonical")))
+    {
+        printf("Error: Invalid number of arguments.\n");
+        printf("Usage: %s --enumerate [puzzleString] [shard] [shards] [output] [--canonical]\n", argv[0]);
+        printf("Example: %s --enumerate '                ' 0 4 shard0.txt\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!validatePuzzleString(argv[2]))
+    {
+        return EXIT_FAILURE;
+    }
+
+    Puzzle puzzle = getPuzzle(argv[2]);
+    Shard shard = {
+        .prefix_rows = 2,
+        .index = atoi(argv[3]),
+        .count = atoi(argv[4]),
+        .canonical = argc == 7
+    };
+
+    if (shard.count < 1 || shard.index < 0 || shard.index >= shard.count)
+    {
+        printf("Error: Invalid shard %s of %s.\n", argv[3], argv[4]);
+        return EXIT_FAILURE;
+    }
+
+    char checkpoint[4096];
+    snprintf(checkpoint, sizeof(checkpoint), "%s.checkpoint", argv[5]);
+
+    ShardResult result = runShard(&puzzle, &shard, argv[5], checkpoint);
+    if (result == SHARD_MISMATCH)
+    {
+        printf("Error: %s belongs to another puzzle or shard, remove it to start over.\n", checkpoint);
+        return EXIT_FAILURE;
+    }
+    if (result != SHARD_DONE)
+    {
+        printf("Error: Could not write %s or %s.\n", argv[5], checkpoint);
+        return EXIT_FAILURE;
+    }
+
+    printf("Shard %d of %d done.\n", shard.index, shard.count);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Builds a sorted store from files of solutions.
+ *
+ * Usage: --store [output] [input...]
+ * Each line of the inputs starts with a complete grid as a puzzle string,
+ * as written by --enumerate; empty lines are skipped. Any other line, or a
+ * grid of another size than the first, is an error and no store is written.
+ */
+static int store(int argc, char** argv)
+{
+    if (argc < 4)
+    {
+        printf("Error: Invalid number of arguments.\n");
+        printf("Usage: %s --store [output] [input...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    StoreWriter* writer = NULL;
+    unsigned size = 0;
+    char line[256];
+    char puzzleString[MAX_PUZZLE_STRING];
+
+    for (int i = 3; i < argc; i++)
+    {
+        FILE* input = fopen(argv[i], "r");
+        if (!input)
+        {
+            printf("Error: Could not read %s.\n", argv[i]);
+            if (writer) { discardStoreWriter(writer); }
+            return EXIT_FAILURE;
+        }
+
+        bool failed = false;
+        for (int number = 1; !failed && fgets(line, sizeof(line), input); number++)
+        {
+            if (sscanf(line, "%79s", puzzleString) != 1) { continue; }
+
+            bool readable = validatePuzzleString(puzzleString);
+            Puzzle grid = readable ? getPuzzle(puzzleString) : (Puzzle) { 0 };
+            if (!readable || getHeight(&grid) != grid.size || getEmpty(&grid) || !isValid(&grid))
+            {
+                printf("Error: Line %d of %s is not a complete, valid square grid.\n", number, argv[i]);
+                failed = true;
+            }
+            else if (writer && grid.size != size)
+            {
+                printf("Error: Line %d of %s has a %ux%u grid, the store holds %ux%u grids.\n",
+                    number, argv[i], grid.size, grid.size, size, size);
+                failed = true;
+            }
+            else
+            {
+                if (!writer) { writer = createStoreWriter(argv[2], size = grid.size, 256 << 20); }
+                failed = !writer || !addToStore(writer, &grid);
+                if (failed) { printf("Error: Could not write %s.\n", argv[2]); }
+            }
+        }
+        fclose(input);
+
+        if (failed)
+        {
+            if (writer) { discardStoreWriter(writer); }
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!writer || !closeStoreWriter(writer))
+    {
+        printf("Error: Could not write %s.\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+static bool printGrid(const Puzzle* grid, void* context)
+{
+    char puzzleString[MAX_PUZZLE_STRING];
+    formatPuzzle(grid, puzzleString);
+    printf("%s\n", puzzleString);
+    return true;
+}
+
+/**
+ * @brief Prints the grids in a store that start with the given rows.
+ *
+ * Usage: --lookup [store] [rows]
+ * The rows are given as '0's and '1's, row 0 first, and may be empty.
+ */
+static int lookup(int argc, char** argv)
+{
+    if (argc != 4)
+    {
+        printf("Error: Invalid number of arguments.\n");
+        printf("Usage: %s --lookup [store] [rows]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (strspn(argv[3], "01") != strlen(argv[3]) || strlen(argv[3]) > 64)
+    {
+        printf("Error: Rows must be whole rows of '0's and '1's.\n");
+        return EXIT_FAILURE;
+    }
+
+    StoreReader* reader = openStore(argv[2]);
+    if (!reader)
+    {
+        printf("Error: Could not open store %s.\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    Puzzle prefix = getPuzzle(argv[3]);
+    prefix.size = getStoreSize(reader);
+    unsigned rows = strlen(argv[3]) / prefix.size;
+
+    if (strlen(argv[3]) % prefix.size || rows > prefix.size)
+    {
+        printf("Error: Rows must be whole rows of '0's and '1's.\n");
+        closeStore(reader);
+        return EXIT_FAILURE;
+    }
+
+    unsigned long long found = findPrefix(reader, &prefix, rows, printGrid, NULL);
+    printf("%llu of %llu grids found.\n", found, countStore(reader));
+    closeStore(reader);
+    return EXIT_SUCCESS;
+}
+
+static void printProgress(int done, int total, const Puzzle* best, void* context)
+{
+    printf("Grid %d of %d done, fewest clues so far: %d\n", done, total, countClues(best));
+    fflush(stdout);
+}
+
+/**
+ * @brief Searches for puzzles with as few clues as possible.
+ *
+ * Usage: --minimal [size] [grids] [threads] [nodes]
+ * Draws uniformly random solution grids of the given size and runs the
+ * minimal clue search on each, with at most the given number of nodes per
+ * grid. Prints the puzzle with the fewest clues.
+ */
+static int minimal(int argc, char** argv)
+{
+    if (argc != 6)
+    {
+        printf("Error: Invalid number of arguments.\n");
+        printf("Usage: %s --minimal [size] [grids] [threads] [nodes]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    unsigned size = atoi(argv[2]);
+    int count = atoi(argv[3]);
+    Ranking* ranking = size >= 4 && count >= 1 ? createRanking(size) : NULL;
+    if (!ranking)
+    {
+        printf("Error: Size must be 4, 6 or 8 and at least one grid is needed.\n");
+        freeRanking(ranking);
+        return EXIT_FAILURE;
+    }
+
+    Puzzle* grids = malloc(count * sizeof(Puzzle));
+    Puzzle* results = malloc(count * sizeof(Puzzle));
+    if (!grids || !results)
+    {
+        printf("Error: Out of memory.\n");
+        free(grids);
+        free(results);
+        freeRanking(ranking);
+        return EXIT_FAILURE;
+    }
+
+    unsigned long long random = time(NULL) | 1;
+    for (int i = 0; i < count; i++) { unrankGrid(ranking, drawBelow(&random, countGrids(ranking)), &grids[i]); }
+
+    findMinimalPuzzles(grids, results, NULL, count, atoi(argv[4]), strtoull(argv[5], NULL, 10), printProgress, NULL);
+
+    int best = 0;
+    for (int i = 1; i < count; i++)
+    {
+        if (countClues(&results[i]) < countClues(&results[best])) { best = i; }
+    }
+    printPuzzle(&results[best]);
+
+    free(grids);
+    free(results);
+    freeRanking(ranking);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Generates puzzles of a given grade.
+ *
+ * Usage: --generate [size] [grade] [count]
+ * Prints each puzzle as a puzzle string, followed by the acceptance rate
+ * and throughput of the generator.
+ */
+static int generate(int argc, char** argv)
+{
+    if (argc != 5)
+    {
+        printf("Error: Invalid number of arguments.\n");
+        printf("Usage: %s --generate [size] [grade] [count]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    unsigned size = atoi(argv[2]);
+    int grade = atoi(argv[3]);
+    int count = atoi(argv[4]);
+    Ranking* ranking = size >= 4 && grade >= 1 && grade <= MAX_GRADE ? createRanking(size) : NULL;
+    if (!ranking)
+    {
+        printf("Error: Size must be 4, 6 or 8 and grade must be 1 to %d.\n", MAX_GRADE);
+        return EXIT_FAILURE;
+    }
+
+    GeneratorStats stats = { 0 };
+    unsigned long long random = time(NULL) | 1;
+    char puzzleString[MAX_PUZZLE_STRING];
+
+    for (int i = 0; i < count; i++)
+    {
+        Puzzle puzzle = { 0 };
+        if (!generatePuzzle(ranking, grade, &random, 1000, &puzzle, &stats))
+        {
+            printf("Error: No puzzle of grade %d found in 1000 attempts.\n", grade);
+            break;
+        }
+        formatPuzzle(&puzzle, puzzleString);
+        printf("'%s'\n", puzzleString);
+    }
+
+    printf("Accepted %llu of %llu attempts (%.1f%%), %.1f puzzles per second.\n",
+        stats.accepted, stats.attempts, 100.0 * stats.accepted / (stats.attempts ? stats.attempts : 1),
+        stats.seconds > 0 ? stats.accepted / stats.seconds : 0);
+    freeRanking(ranking);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Reads a puzzle string from a line of a puzzle file.
+ *
+ * The puzzle string may be in quotes, as printed by --generate.
+ *
+ * @return false if the line does not start with a puzzle string.
+ */
+static bool readPuzzleLine(char* line, Puzzle* puzzle)
+{
+    char* puzzleString = line + (line[0] == '\'');
+    size_t length = strspn(puzzleString, "01 ");
+    if (length != 16 && length != 36 && length != 64) { return false; }
+
+    puzzleString[length] = '\0';
+    *puzzle = getPuzzle(puzzleString);
+    return true;
+}
+
+/**
+ * @brief Removes symmetric duplicates from a file of puzzles.
+ *
+ * Usage: --dedup [input] [output]
+ * Each line of the input holds a puzzle string, see readPuzzleLine().
+ * Lines that are not puzzle strings are skipped.
+ */
+static int dedup(int argc, char** argv)
+{
+    if (argc != 4)
+    {
+        printf("Error: Invalid number of arguments.\n");
+        printf("Usage: %s --dedup [input] [output]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE* input = fopen(argv[2], "r");
+    FILE* output = input ? fopen(argv[3], "w") : NULL;
+    char spillPath[4096];
+    snprintf(spillPath, sizeof(spillPath), "%s.part", argv[3]);
+    Dedup* dedup = output ? createDedup(256 << 20, spillPath, output) : NULL;
+    if (!dedup)
+    {
+        printf("Error: Could not open %s or %s.\n", argv[2], argv[3]);
+        if (input) { fclose(input); }
+        if (output) { fclose(output); }
+        return EXIT_FAILURE;
+    }
+
+    char line[256];
+    bool written = true;
+    while (written && fgets(line, sizeof(line), input))
+    {
+        Puzzle puzzle = { 0 };
+        if (readPuzzleLine(line, &puzzle)) { written = addToDedup(dedup, &puzzle); }
+    }
+
+    DedupStats stats;
+    written = finishDedup(dedup, &stats) && written;
+    fclose(input);
+    written = !fclose(output) && written;
+    if (!written)
+    {
+        printf("Error: Could not write %s.\n", argv[3]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%llu of %llu puzzles unique, %llu spilled to disk.\n", stats.unique, stats.seen, stats.spilled);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Builds a catalog of puzzles bucketed by size and grade.
+ *
+ * Usage: --catalog [output] [input...]
+ * Each line of the inputs holds a puzzle string, see readPuzzleLine().
+ * Puzzles without a unique solution are skipped.
+ */
+static int catalog(int argc, char** argv)
+{
+    if (argc < 4)
+    {
+        printf("Error: Invalid number of arguments.\n");
+        printf("Usage: %s --catalog [output] [input...]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    CatalogWriter* writer = createCatalogWriter(argv[2]);
+    unsigned long long added = 0, skipped = 0;
+    char line[256];
+    bool written = writer != NULL;
+
+    for (int i = 3; i < argc && written; i++)
+    {
+        FILE* input = fopen(argv[i], "r");
+        if (!input)
+        {
+            printf("Error: Could not read %s.\n", argv[i]);
+            discardCatalogWriter(writer);
+            return EXIT_FAILURE;
+        }
+
+        while (written && fgets(line, sizeof(line), input))
+        {
+            Puzzle puzzle = { 0 };
+            if (!readPuzzleLine(line, &puzzle)) { continue; }
+
+            int grade = addToCatalog(writer, &puzzle);
+            written = grade >= 0;
+            if (grade > 0) { added++; }
+            else { skipped++; }
+        }
+        fclose(input);
+    }
+
+    if (writer && !written) { discardCatalogWriter(writer); }
+    if (!writer || !written || !closeCatalogWriter(writer))
+    {
+        printf("Error: Could not write %s.\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    printf("%llu puzzles added, %llu skipped.\n", added, skipped);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Prints a random puzzle of a size and grade from a catalog.
+ *
+ * Usage: --sample [catalog] [size] [grade]
+ */
+static int sample(int argc, char** argv)
+{
+    if (argc != 5)
+    {
+        printf("Error: Invalid number of arguments.\n");
+        printf("Usage: %s --sample [catalog] [size] [grade]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Catalog* catalog = openCatalog(argv[2]);
+    if (!catalog)
+    {
+        printf("Error: Could not open catalog %s.\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    Puzzle puzzle = { 0 };
+    char puzzleString[MAX_PUZZLE_STRING];
+    unsigned long long random = (unsigned long long) time(NULL) * 0x9E3779B97F4A7C15ULL;
+    if (!sampleCatalog(catalog, atoi(argv[3]), atoi(argv[4]), random >> 17, &puzzle))
+    {
+        printf("Error: The catalog has no puzzle of size %s and grade %s.\n", argv[3], argv[4]);
+        closeCatalog(catalog);
+        return EXIT_FAILURE;
+    }
+
+    formatPuzzle(&puzzle, puzzleString);
+    printf("'%s'\n", puzzleString);
+    closeCatalog(catalog);
+    return EXIT_SUCCESS;
+}
+
+static bool printPair(int a, int b, int distance, void* context)
+{
+    printf("Lines %d and %d are %d clue changes apart.\n", ((int*) context)[a], ((int*) context)[b], distance);
+    return true;
+}
+
+/**
+ * @brief Lists the pairs of puzzles in a file that differ in few clues.
+ *
+ * Usage: --near [input] [radius]
+ * Adding or removing a clue counts as one change, flipping a clue as two.
+ * Puzzles of another size than the first one are skipped.
+ */
+static int near(int argc, char** argv)
+{
+    if (argc != 4)
+    {
+        printf("Error: Invalid number of arguments.\n");
+        printf("Usage: %s --near [input] [radius]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE* input = fopen(argv[2], "r");
+    if (!input)
+    {
+        printf("Error: Could not read %s.\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    Puzzle* puzzles = NULL;
+    int* lines = NULL;
+    int count = 0, capacity = 0, number = 0;
+    char line[256];
+    bool read = true;
+
+    while (read && fgets(line, sizeof(line), input))
+    {
+        Puzzle puzzle = { 0 };
+        number++;
+        if (!readPuzzleLine(line, &puzzle) || (count && puzzle.size != puzzles[0].size)) { continue; }
+
+        if (count == capacity)
+        {
+            capacity = capacity ? 2 * capacity : 1024;
+            Puzzle* grown = realloc(puzzles, capacity * sizeof(Puzzle));
+            int* grown_lines = grown ? realloc(lines, capacity * sizeof(int)) : NULL;
+            if (grown) { puzzles = grown; }
+            if (grown_lines) { lines = grown_lines; }
+            read = grown && grown_lines;
+        }
+        if (read)
+        {
+            puzzles[count] = puzzle;
+            lines[count++] = number;
+        }
+    }
+    fclose(input);
+
+    NearIndex* index = read ? createNearIndex(puzzles, count) : NULL;
+    if (!index)
+    {
+        printf("Error: Out of memory.\n");
+        free(puzzles);
+        free(lines);
+        return EXIT_FAILURE;
+    }
+
+    unsigned long long pairs = findNearPairs(index, atoi(argv[3]), printPair, lines);
+    printf("%llu pairs among %d puzzles.\n", pairs, count);
+
+    freeNearIndex(index);
+    free(puzzles);
+    free(lines);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Solves every puzzle in a file with the batch API.
+ *
+ * Usage: --batch [input] [threads]
+ * Each line of the input holds a puzzle string, see readPuzzleLine(). Prints
+ * a solution per puzzle, or why there is none, followed by the throughput
+ * and the latency percentiles per size and outcome.
+ */
+static int batch(int argc, char** argv)
+{
+    if (argc != 4)
+    {
+        printf("Error: Invalid number of arguments.\n");
+        printf("Usage: %s --batch [input] [threads]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE* input = fopen(argv[2], "r");
+    if (!input)
+    {
+        printf("Error: Could not read %s.\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+
+    unsigned long long* grids = NULL;
+    unsigned long long* actions = NULL;
+    unsigned* sizes = NULL;
+    size_t count = 0, capacity = 0;
+    char line[256];
+    bool read = true;
+
+    while (read && fgets(line, sizeof(line), input))
+    {
+        Puzzle puzzle = { 0 };
+        if (!readPuzzleLine(line, &puzzle)) { continue; }
+
+        if (count == capacity)
+        {
+            capacity = capacity ? 2 * capacity : 1024;
+            unsigned long long* grown_grids = realloc(grids, capacity * sizeof(unsigned long long));
+            if (grown_grids) { grids = grown_grids; }
+            unsigned long long* grown_actions = realloc(actions, capacity * sizeof(unsigned long long));
+            if (grown_actions) { actions = grown_actions; }
+            unsigned* grown_sizes = realloc(sizes, capacity * sizeof(unsigned));
+            if (grown_sizes) { sizes = grown_sizes; }
+            read = grown_grids && grown_actions && grown_sizes;
+        }
+        if (read)
+        {
+            grids[count] = puzzle.grid;
+            actions[count] = getEmpty(&puzzle);
+            sizes[count++] = puzzle.size;
+        }
+    }
+    fclose(input);
+
+    unsigned long long* solutions = read ? malloc((count ? count : 1) * sizeof(unsigned long long)) : NULL;
+    int* statuses = solutions ? malloc((count ? count : 1) * sizeof(int)) : NULL;
+    Latency* latency = statuses ? createLatency() : NULL;
+    if (!latency)
+    {
+        printf("Error: Out of memory.\n");
+        free(grids);
+        free(actions);
+        free(sizes);
+        free(solutions);
+        free(statuses);
+        return EXIT_FAILURE;
+    }
+
+    struct timespec begin, end;
+    measurePhase(PHASE_SEARCH);
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    size_t solved = solveBatchTimed(grids, actions, sizes, NULL, solutions, statuses, count, atoi(argv[3]), latency);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    measurePhase(PHASE_OUTPUT);
+    double seconds = end.tv_sec - begin.tv_sec + (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    const char* reasons[] = { "", " (not unique)", "No solution", "Invalid puzzle" };
+    char puzzleString[MAX_PUZZLE_STRING];
+    for (size_t i = 0; i < count; i++)
+    {
+        if (statuses[i] > BATCH_MULTIPLE)
+        {
+            printf("%s\n", reasons[statuses[i]]);
+            continue;
+        }
+        Puzzle solution = { .grid = solutions[i], .actions = 0, .size = sizes[i] };
+        formatPuzzle(&solution, puzzleString);
+        printf("'%s'%s\n", puzzleString, reasons[statuses[i]]);
+    }
+    printf("%zu of %zu puzzles solved, %.1f puzzles per second.\n", solved, count, seconds > 0 ? count / seconds : 0);
+    printLatency(latency, stdout);
+
+    free(grids);
+    free(actions);
+    free(sizes);
+    free(solutions);
+    free(statuses);
+    freeLatency(latency);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Prints the search recorded in a trace file as a tree.
+ *
+ * Usage: --trace-tree [input]
+ * The input is written by solving a puzzle with --trace.
+ */
+static int traceTree(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        printf("Error: Invalid number of arguments.\n");
+        printf("Usage: %s --trace-tree [input]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (!printTraceTree(argv[2], stdout))
+    {
+        printf("Error: Could not read trace %s.\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
 int main(int argc, char** argv)
 {
-    if (argc != 2)
+    while (argc > 1 && !strcmp(argv[1], "--counters") && !counting)
+    {
+        counting = true;
+        openCounters(&counters);
+        atexit(reportCounters);
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+    }
+
+    if (argc > 2 && !strcmp(argv[1], "--cpu"))
+    {
+        CpuLevel level;
+        if (!parseCpuLevel(argv[2], &level) || !forceCpuLevel(level))
+        {
+            printf("Error: Level %s is unknown or not supported, this CPU supports up to %s.\n",
+                argv[2], getCpuLevelName(detectCpuLevel()));
+            return EXIT_FAILURE;
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    const char* tracePath = NULL;
+    if (argc > 2 && !strcmp(argv[1], "--trace"))
+    {
+        tracePath = argv[2];
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
+
+    if (argc > 1 && !strcmp(argv[1], "--trace-tree"))
+    {
+        return traceTree(argc, argv);
+    }
+
+    if (argc > 1 && !strcmp(argv[1], "--enumerate"))
+    {
+        return enumerate(argc, argv);
+    }
+
+    if (argc > 1 && !strcmp(argv[1], "--store"))
+    {
+        return store(argc, argv);
+    }
+
+    if (argc > 1 && !strcmp(argv[1], "--lookup"))
+    {
+        return lookup(argc, argv);
+    }
+
+    if (argc > 1 && !strcmp(argv[1], "--minimal"))
+    {
+        return minimal(argc, argv);
+    }
+
+    if (argc > 1 && !strcmp(argv[1], "--generate"))
+    {
+        return generate(argc, argv);
+    }
+
+    if (argc > 1 && !strcmp(argv[1], "--dedup"))
+    {
+        return dedup(argc, argv);
+    }
+
+    if (argc > 1 && !strcmp(argv[1], "--near"))
+    {
+        return near(argc, argv);
+    }
+
+    if (argc > 1 && !strcmp(argv[1], "--catalog"))
+    {
+        return catalog(argc, argv);
+    }
+
+    if (argc > 1 && !strcmp(argv[1], "--sample"))
+    {
+        return sample(argc, argv);
+    }
+
+    if (argc > 1 && !strcmp(argv[1], "--batch"))
+    {
+        return batch(argc, argv);
+    }
+
+    if (argc != 2 && argc != 3)
     {
         printf("Error: Invalid number of arguments.\n");
-        printf("Usage: %s [puzzleString]\n", argv[0]);
+        printf("Usage: %s [--counters] [--cpu level] [--trace output] [puzzleString] [edgeString]\n", argv[0]);
+        printf("       %s --enumerate [puzzleString] [shard] [shards] [output] [--canonical]\n", argv[0]);
+        printf("       %s --store [output] [input...]\n", argv[0]);
+        printf("       %s --lookup [store] [rows]\n", argv[0]);
+        printf("       %s --minimal [size] [grids] [threads] [nodes]\n", argv[0]);
+        printf("       %s --generate [size] [grade] [count]\n", argv[0]);
+        printf("       %s --dedup [input] [output]\n", argv[0]);
+        printf("       %s --near [input] [radius]\n", argv[0]);
+        printf("       %s --catalog [output] [input...]\n", argv[0]);
+        printf("       %s --sample [catalog] [size] [grade]\n", argv[0]);
+        printf("       %s --batch [input] [threads]\n", argv[0]);
+        printf("       %s --trace-tree [input]\n", argv[0]);
         printf("Example: %s '0  1      000  0'\n", argv[0]);
         return EXIT_FAILURE;
     }
@@ -20,20 +855,44 @@ int main(int argc, char** argv)
 
     Puzzle puzzle = getPuzzle(argv[1]);
 
+    if (argc == 3)
+    {
+        if (!validateEdgeString(&puzzle, argv[2])) { return EXIT_FAILURE; }
+        getEdges(argv[2], &puzzle);
+    }
+
     if (!isValid(&puzzle))
     {
         printf("Error: Invalid puzzle provided.\n");
+        printConflict(&puzzle);
+        return EXIT_FAILURE;
+    }
+
+    Trace* trace = tracePath ? createTrace(TRACE_EVENTS) : NULL;
+    if (tracePath && !trace)
+    {
+        printf("Error: Could not allocate the trace.\n");
         return EXIT_FAILURE;
     }
 
-    if (solve(puzzle))
+    bool solved = trace ? solveTraced(puzzle, trace) : counting ? solveMeasured(&puzzle) : solve(puzzle);
+    if (solved)
     {
         printf("Solved!\n");
     }
     else
     {
         printf("No solution found...\n");
+        printConflict(&puzzle);
+    }
+
+    if (trace && !writeTrace(trace, tracePath))
+    {
+        printf("Error: Could not write trace %s.\n", tracePath);
+        freeTrace(trace);
+        return EXIT_FAILURE;
     }
+    freeTrace(trace);
   
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,347 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "near.h"
+
+#define MAX_CHUNKS 8
+#define MAX_CHUNK_RADIUS 3
+
+
+struct NearIndex
+{
+    unsigned size;
+    unsigned height;
+    int count;
+    int chunks;
+    int start[MAX_CHUNKS];
+    int width[MAX_CHUNKS];
+    int* offsets[MAX_CHUNKS];
+    int* ids[MAX_CHUNKS];
+    unsigned long long (*vectors)[2];
+    unsigned* stamps;
+    unsigned stamp;
+};
+
+typedef struct
+{
+    NearIndex* index;
+    unsigned long long vector[2];
+    int radius;
+    Neighbour* results;
+    int max;
+    int found;
+    bool nearest;
+    int self;
+    PairCallback callback;
+    void* context;
+    bool stopped;
+} Query;
+
+/**
+ * @brief Encodes the clues of a puzzle as a bit vector of 2*cells bits.
+ *
+ * The low cells bits mark the cells with a clue 1, the next cells
+ * bits the cells with a clue 0, so the Hamming distance between two vectors
+ * counts an added or removed clue once and a flipped clue twice. Empty cells
+ * are 0 in both halves, whatever their grid bit holds.
+ */
+static void getVector(const Puzzle* puzzle, unsigned long long vector[2])
+{
+    unsigned cells = puzzle->size * getHeight(puzzle);
+    unsigned long long board = cells < 64 ? (1ULL << cells) - 1 : -1ULL;
+    unsigned long long clues = ~getEmpty(puzzle) & board;
+    unsigned long long ones = puzzle->grid & clues;
+    unsigned long long zeros = ~puzzle->grid & clues;
+
+    vector[0] = cells < 64 ? ones | zeros << cells : ones;
+    vector[1] = cells < 64 ? zeros >> (64 - cells) : zeros;
+}
+
+static int getVectorDistance(const unsigned long long a[2], const unsigned long long b[2])
+{
+    return __builtin_popcountll(a[0] ^ b[0]) + __builtin_popcountll(a[1] ^ b[1]);
+}
+
+/**
+ * @brief Computes the number of clue changes between two puzzles.
+ *
+ * Adding or removing a clue counts 1, flipping a clue counts 2. Puzzles of
+ * different sizes are compared as if the smaller one was padded with empty
+ * cells, so their distance is not meaningful.
+ */
+int getDistance(const Puzzle* a, const Puzzle* b)
+{
+    unsigned long long vector_a[2], vector_b[2];
+    getVector(a, vector_a);
+    getVector(b, vector_b);
+    return getVectorDistance(vector_a, vector_b);
+}
+
+static unsigned getChunk(const NearIndex* index, const unsigned long long vector[2], int chunk)
+{
+    int start = index->start[chunk];
+    unsigned long long bits;
+    if (start >= 64) { bits = vector[1] >> (start - 64); }
+    else if (start && start + index->width[chunk] > 64) { bits = vector[0] >> start | vector[1] << (64 - start); }
+    else { bits = vector[0] >> start; }
+    return bits & ((1U << index->width[chunk]) - 1);
+}
+
+/**
+ * @brief Builds a multi-index hash over the clue vectors of some puzzles.
+ *
+ * The 2*cells bit vectors (see getVector()) are split into up to 8
+ * chunks of at most 16 bits, and each chunk gets a table from its value to
+ * the puzzles having that value. If two vectors are within distance r, some
+ * chunk differs in at most r/chunks bits, so a query only has to look at
+ * the buckets near each of its chunks and verify the candidates with a
+ * popcount. The tables are laid out as one offset array per chunk into a
+ * sorted array of ids.
+ *
+ * @param puzzles The puzzles to be indexed, all of the same width and height.
+ * @param count The number of puzzles, ids are their positions.
+ *
+ * @return The index, or NULL if the sizes differ or memory ran out.
+ */
+NearIndex* createNearIndex(const Puzzle puzzles[], int count)
+{
+    NearIndex* index = calloc(1, sizeof(NearIndex));
+    if (!index) { return NULL; }
+
+    index->size = count ? puzzles[0].size : 4;
+    index->height = count ? getHeight(&puzzles[0]) : 4;
+    index->count = count;
+    int bits = 2 * index->size * index->height;
+    index->chunks = (bits + 15) / 16;
+    for (int j = 0, start = 0; j < index->chunks; j++)
+    {
+        index->start[j] = start;
+        index->width[j] = bits / index->chunks + (j < bits % index->chunks);
+        start += index->width[j];
+    }
+
+    index->vectors = malloc((count ? count : 1) * sizeof(*index->vectors));
+    index->stamps = calloc(count ? count : 1, sizeof(unsigned));
+    bool created = index->vectors && index->stamps;
+
+    for (int i = 0; i < count && created; i++)
+    {
+        created = puzzles[i].size == index->size && getHeight(&puzzles[i]) == index->height;
+        getVector(&puzzles[i], index->vectors[i]);
+    }
+
+    for (int j = 0; j < index->chunks && created; j++)
+    {
+        int buckets = 1 << index->width[j];
+        index->offsets[j] = calloc(buckets + 1, sizeof(int));
+        index->ids[j] = malloc((count ? count : 1) * sizeof(int));
+        if (!index->offsets[j] || !index->ids[j])
+        {
+            created = false;
+            break;
+        }
+
+        for (int i = 0; i < count; i++) { index->offsets[j][getChunk(index, index->vectors[i], j) + 1]++; }
+        for (int b = 0; b < buckets; b++) { index->offsets[j][b + 1] += index->offsets[j][b]; }
+        for (int i = 0; i < count; i++) { index->ids[j][index->offsets[j][getChunk(index, index->vectors[i], j)]++] = i; }
+        for (int b = buckets; b > 0; b--) { index->offsets[j][b] = index->offsets[j][b - 1]; }
+        index->offsets[j][0] = 0;
+    }
+
+    if (!created)
+    {
+        freeNearIndex(index);
+        return NULL;
+    }
+    return index;
+}
+
+void freeNearIndex(NearIndex* index)
+{
+    if (!index) { return; }
+    for (int j = 0; j < index->chunks; j++)
+    {
+        free(index->offsets[j]);
+        free(index->ids[j]);
+    }
+    free(index->vectors);
+    free(index->stamps);
+    free(index);
+}
+
+/**
+ * @brief Verifies a candidate and records it if it is close enough.
+ *
+ * Every puzzle is verified at most once per query, tracked by stamping it
+ * with the number of the query.
+ */
+static void addCandidate(Query* query, int id)
+{
+    NearIndex* index = query->index;
+    if (index->stamps[id] == index->stamp || query->stopped) { return; }
+    index->stamps[id] = index->stamp;
+
+    int distance = getVectorDistance(query->vector, index->vectors[id]);
+    if (distance > query->radius) { return; }
+
+    if (query->callback)
+    {
+        if (id > query->self && !query->callback(query->self, id, distance, query->context)) { query->stopped = true; }
+        query->found += id > query->self;
+    }
+    else if (query->nearest)
+    {
+        int i = query->found < query->max ? query->found++ : query->max;
+        for (; i > 0 && query->results[i - 1].distance > distance; i--)
+        {
+            if (i < query->max) { query->results[i] = query->results[i - 1]; }
+        }
+        if (i < query->max) { query->results[i] = (Neighbour) { .id = id, .distance = distance }; }
+    }
+    else
+    {
+        if (query->found < query->max) { query->results[query->found] = (Neighbour) { .id = id, .distance = distance }; }
+        query->found++;
+    }
+}
+
+/**
+ * @brief Visits every bucket of a chunk within some number of bit flips.
+ *
+ * Each value is visited exactly once, by only flipping bits above the last
+ * flipped one.
+ */
+static void visitBall(Query* query, int chunk, unsigned value, int bit, int flips)
+{
+    const NearIndex* index = query->index;
+    for (int i = index->offsets[chunk][value]; i < index->offsets[chunk][value + 1]; i++)
+    {
+        addCandidate(query, index->ids[chunk][i]);
+    }
+    for (int i = bit; i < index->width[chunk] && flips; i++)
+    {
+        visitBall(query, chunk, value ^ 1U << i, i + 1, flips - 1);
+    }
+}
+
+/**
+ * @brief Visits all puzzles that have a chunk within the given bit flips.
+ *
+ * Beyond MAX_CHUNK_RADIUS flips the balls cover so many buckets that a
+ * linear scan over all puzzles is cheaper.
+ */
+static void visitChunks(Query* query, int flips)
+{
+    NearIndex* index = query->index;
+    if (flips > MAX_CHUNK_RADIUS)
+    {
+        for (int i = 0; i < index->count; i++) { addCandidate(query, i); }
+        return;
+    }
+    for (int j = 0; j < index->chunks; j++)
+    {
+        visitBall(query, j, getChunk(index, query->vector, j), 0, flips);
+    }
+}
+
+static Query startQuery(NearIndex* index, const Puzzle* puzzle)
+{
+    Query query = { .index = index, .self = -1 };
+    if (puzzle) { getVector(puzzle, query.vector); }
+
+    if (!++index->stamp)
+    {
+        memset(index->stamps, 0, (index->count ? index->count : 1) * sizeof(unsigned));
+        index->stamp = 1;
+    }
+    return query;
+}
+
+/**
+ * @brief Finds the indexed puzzles within a distance of a query puzzle.
+ *
+ * @param index The index to search.
+ * @param query The puzzle to search for, of the size of the index.
+ * @param radius The largest distance to report, see getDistance().
+ * @param results Receives the matches, in no particular order.
+ * @param max The number of matches results can hold.
+ *
+ * @return The number of matches, which may exceed max.
+ */
+int findWithin(NearIndex* index, const Puzzle* query, int radius, Neighbour results[], int max)
+{
+    if (query->size != index->size || getHeight(query) != index->height || radius < 0) { return 0; }
+
+    Query search = startQuery(index, query);
+    search.radius = radius;
+    search.results = results;
+    search.max = max;
+    visitChunks(&search, radius / index->chunks);
+    return search.found;
+}
+
+/**
+ * @brief Finds the k indexed puzzles closest to a query puzzle.
+ *
+ * The chunk radius grows from 0 until the k-th best distance is known to be
+ * final: after searching every chunk within s flips, all puzzles not seen
+ * yet differ in more than s bits in every chunk, so they are at least
+ * chunks*(s+1) away.
+ *
+ * @param index The index to search.
+ * @param query The puzzle to search for, of the size of the index.
+ * @param k The number of neighbours wanted.
+ * @param results Receives the neighbours, closest first.
+ *
+ * @return The number of neighbours found, k unless fewer are indexed.
+ */
+int findNearest(NearIndex* index, const Puzzle* query, int k, Neighbour results[])
+{
+    if (query->size != index->size || getHeight(query) != index->height || k <= 0) { return 0; }
+
+    Query search = startQuery(index, query);
+    search.radius = INT_MAX;
+    search.results = results;
+    search.max = k;
+    search.nearest = true;
+
+    for (int flips = 0; flips <= MAX_CHUNK_RADIUS + 1; flips++)
+    {
+        visitChunks(&search, flips);
+        if (search.found == k && results[k - 1].distance < index->chunks * (flips + 1)) { break; }
+    }
+    return search.found;
+}
+
+/**
+ * @brief Reports every pair of indexed puzzles within a distance.
+ *
+ * Each puzzle is queried against the index in turn and only the partners
+ * with a higher id are reported, so every pair is reported once.
+ *
+ * @param index The index to search.
+ * @param radius The largest distance to report, see getDistance().
+ * @param callback Called with the ids of each pair (lowest first) and their
+ *                 distance; returning false stops the search.
+ * @param context Passed through to the callback.
+ *
+ * @return The number of pairs reported.
+ */
+unsigned long long findNearPairs(NearIndex* index, int radius, PairCallback callback, void* context)
+{
+    unsigned long long pairs = 0;
+    for (int i = 0; i < index->count && radius >= 0; i++)
+    {
+        Query search = startQuery(index, NULL);
+        memcpy(search.vector, index->vectors[i], sizeof(search.vector));
+        search.radius = radius;
+        search.self = i;
+        search.callback = callback;
+        search.context = context;
+        visitChunks(&search, radius / index->chunks);
+
+        pairs += search.found;
+        if (search.stopped) { break; }
+    }
+    return pairs;
+}
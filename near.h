@@ -0,0 +1,23 @@
+#ifndef NEAR_H
+#define NEAR_H
+
+#include "takuzu.h"
+
+typedef struct NearIndex NearIndex;
+
+typedef struct
+{
+    int id;
+    int distance;
+} Neighbour;
+
+typedef bool (*PairCallback)(int a, int b, int distance, void* context);
+
+int getDistance(const Puzzle* a, const Puzzle* b);
+NearIndex* createNearIndex(const Puzzle puzzles[], int count);
+void freeNearIndex(NearIndex* index);
+int findWithin(NearIndex* index, const Puzzle* query, int radius, Neighbour results[], int max);
+int findNearest(NearIndex* index, const Puzzle* query, int k, Neighbour results[]);
+unsigned long long findNearPairs(NearIndex* index, int radius, PairCallback callback, void* context);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+/* Static tracepoints of the "takuzu" provider. With <sys/sdt.h> (systemtap
+ * headers) each probe is a single nop plus a note in the binary that
+ * tracers such as bpftrace, perf and SystemTap attach to at runtime.
+ * Without it, or with -DTAKUZU_NO_PROBES, the probes compile to nothing;
+ * the arguments are still evaluated, so they must stay free of side effects
+ * and cheap. */
+#if !defined(TAKUZU_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HAS_PROBES 1
+#endif
+#endif
+
+#ifdef HAS_PROBES
+#define PROBE3(name, a, b, c) STAP_PROBE3(takuzu, name, a, b, c)
+#define PROBE5(name, a, b, c, d, e) STAP_PROBE5(takuzu, name, a, b, c, d, e)
+#else
+#define HAS_PROBES 0
+#define PROBE3(name, a, b, c) ((void)(a), (void)(b), (void)(c))
+#define PROBE5(name, a, b, c, d, e) ((void)(a), (void)(b), (void)(c), (void)(d), (void)(e))
+#endif
+
+#endif
@@ -0,0 +1,306 @@
+#include <stddef.h>
+#include "search.h"
+
+
+/**
+ * @brief Fills in the empty cells next to a filled in cell across a marker.
+ *
+ * Works on the whole board at once, like meetsEdges(): shifting the filled
+ * in cells (and their values) by 1 or size moves them onto their neighbour
+ * to the right or below, shifting the other way onto the neighbour to the
+ * left or above. An "=" marker copies the value, an "x" marker its
+ * complement.
+ *
+ * @param puzzle The puzzle to be filled in, updated in place.
+ * @param changed Set to true if any cell was filled in.
+ *
+ * @return false if a cell is forced to both values, true otherwise.
+ */
+static bool fillEdges(Puzzle* puzzle, bool* changed)
+{
+    unsigned long long empty = getEmpty(puzzle);
+    unsigned long long ones = puzzle->grid & ~empty;
+    unsigned long long zeros = ~puzzle->grid & ~empty;
+    unsigned size = puzzle->size;
+
+    unsigned long long to_one =
+        (puzzle->across_equal & ones | puzzle->across_opposite & zeros) << 1 |
+        puzzle->across_equal & ones >> 1 | puzzle->across_opposite & zeros >> 1 |
+        (puzzle->down_equal & ones | puzzle->down_opposite & zeros) << size |
+        puzzle->down_equal & ones >> size | puzzle->down_opposite & zeros >> size;
+    unsigned long long to_zero =
+        (puzzle->across_equal & zeros | puzzle->across_opposite & ones) << 1 |
+        puzzle->across_equal & zeros >> 1 | puzzle->across_opposite & ones >> 1 |
+        (puzzle->down_equal & zeros | puzzle->down_opposite & ones) << size |
+        puzzle->down_equal & zeros >> size | puzzle->down_opposite & ones >> size;
+
+    to_one &= empty;
+    to_zero &= empty;
+    if (to_one & to_zero) { return false; }
+    if (!(to_one | to_zero)) { return true; }
+
+    puzzle->grid = (puzzle->grid & ~to_zero) | to_one;
+    puzzle->actions &= ~(to_one | to_zero);
+    *changed = true;
+    return true;
+}
+
+/**
+ * @brief Fills in every empty cell whose value is forced.
+ *
+ * For each empty cell, both values are tried with isValid(). If only one of
+ * them is valid, the cell must take that value. This is repeated until no
+ * more cells are filled in, since every filled in cell may force others.
+ * The "=" and "x" markers of the edge variant are applied to the whole
+ * board first in each round, see fillEdges().
+ *
+ * @param puzzle The puzzle to be propagated, updated in place.
+ *
+ * @return false if the puzzle turns out to be invalid, true otherwise.
+ */
+bool propagate(Puzzle* puzzle)
+{
+    if (!isValid(puzzle)) { return false; }
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        if (!fillEdges(puzzle, &changed) || (changed && !isValid(puzzle))) { return false; }
+
+        for (int i = 0; i < puzzle->size*getHeight(puzzle); i++)
+        {
+            if (!(puzzle->actions & 1ULL << i)) { continue; }
+
+            Puzzle zero = *puzzle;
+            zero.actions ^= 1ULL << i;
+            Puzzle one = zero;
+            one.grid |= 1ULL << i;
+
+            bool can_zero = isValid(&zero);
+            bool can_one = isValid(&one);
+            if (!can_zero && !can_one) { return false; }
+
+            if (!can_zero) { *puzzle = one; changed = true; }
+            else if (!can_one) { *puzzle = zero; changed = true; }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Counts the solutions of a puzzle, up to a limit.
+ *
+ * Works like solve(), but propagates before branching on the first empty
+ * cell and stops as soon as limit solutions are found. Nothing is printed,
+ * so this is the building block for the queries on top of it, e.g. a limit
+ * of 2 tells whether a puzzle has a unique solution.
+ *
+ * @param puzzle The puzzle to be counted.
+ * @param limit The number of solutions after which to stop.
+ * @param solution Receives the first solution found, may be NULL.
+ *
+ * @return The number of solutions found, at most limit.
+ */
+unsigned long long countSolutions(Puzzle puzzle, unsigned long long limit, Puzzle* solution)
+{
+    if (!limit || !propagate(&puzzle)) { return 0; }
+
+    if (!getEmpty(&puzzle))
+    {
+        if (solution) { *solution = puzzle; }
+        return 1;
+    }
+
+    int i = 0;
+    while (!(puzzle.actions & 1ULL << i)) { i++; }
+
+    puzzle.actions ^= 1ULL << i;
+    unsigned long long count = countSolutions(puzzle, limit, solution);
+
+    if (count < limit)
+    {
+        puzzle.grid |= 1ULL << i;
+        count += countSolutions(puzzle, limit - count, count ? NULL : solution);
+    }
+    return count;
+}
+
+/**
+ * @brief Tells whether a puzzle has a solution, within a budget of nodes.
+ *
+ * Works like countSolutions() with a limit of 1, but stops once max_nodes
+ * nodes have been visited in total, counting those in nodes already.
+ *
+ * @param puzzle The puzzle to be checked.
+ * @param max_nodes The maximum number of nodes to search.
+ * @param nodes The number of nodes visited so far, updated in place.
+ *
+ * @return true if a solution was found, false if there is none or the
+ *         budget ran out, which is the case if nodes reached max_nodes.
+ */
+static bool hasSolutionWithin(Puzzle puzzle, unsigned long long max_nodes, unsigned long long* nodes)
+{
+    if (*nodes >= max_nodes) { return false; }
+    ++*nodes;
+    if (!propagate(&puzzle)) { return false; }
+    if (!getEmpty(&puzzle)) { return true; }
+
+    int i = 0;
+    while (!(puzzle.actions & 1ULL << i)) { i++; }
+
+    puzzle.actions ^= 1ULL << i;
+    if (hasSolutionWithin(puzzle, max_nodes, nodes)) { return true; }
+
+    puzzle.grid |= 1ULL << i;
+    return hasSolutionWithin(puzzle, max_nodes, nodes);
+}
+
+/**
+ * @brief Extracts a minimal set of clues that has no solution on its own.
+ *
+ * Deletion-based: each clue is removed in turn and stays removed if the
+ * remaining clues still have no solution. Removing clues never removes
+ * solutions, so a clue that had to stay has to stay until the end and a
+ * single pass yields a minimal subset, i.e. removing any of its clues makes
+ * it solvable.
+ *
+ * Every check shares one budget of nodes. A clue whose check runs out of it,
+ * and every clue after it, is kept, so the result still has no solution but
+ * may not be minimal.
+ *
+ * @param puzzle A puzzle without solutions.
+ * @param max_nodes The maximum number of nodes to search.
+ * @param exact Receives whether the pass completed, i.e. whether the result
+ *              is minimal. May be NULL.
+ *
+ * @return A puzzle containing only the conflicting clues.
+ */
+Puzzle getConflict(const Puzzle* puzzle, unsigned long long max_nodes, bool* exact)
+{
+    Puzzle conflict = *puzzle;
+    unsigned long long nodes = 0;
+    for (int i = 0; i < puzzle->size*getHeight(puzzle) && nodes < max_nodes; i++)
+    {
+        if (conflict.actions & 1ULL << i) { continue; }
+
+        Puzzle reduced = conflict;
+        reduced.actions |= 1ULL << i;
+        reduced.grid &= ~(1ULL << i);
+        if (!hasSolutionWithin(reduced, max_nodes, &nodes) && nodes < max_nodes) { conflict = reduced; }
+    }
+    if (exact) { *exact = nodes < max_nodes; }
+    return conflict;
+}
+
+/**
+ * @brief Starts a stack of assumptions on top of a base puzzle.
+ *
+ * The base is propagated once here; every assumption starts from the state
+ * below it on the stack, so queries never redo the work of the base. Since
+ * propagation only ever adds cells, the base should hold the clues that all
+ * queries share, e.g. those that can no longer be removed, and the clues
+ * that vary from query to query are pushed with assumeClues() and taken
+ * away again with retract().
+ *
+ * @param assumptions The stack to be initialised.
+ * @param base The puzzle the assumptions are layered on.
+ */
+void initAssumptions(Assumptions* assumptions, const Puzzle* base)
+{
+    assumptions->depth = 0;
+    assumptions->stack[0] = *base;
+    assumptions->consistent[0] = propagate(&assumptions->stack[0]);
+}
+
+/**
+ * @brief Temporarily fixes some cells to the values they have in a puzzle
+ *        and propagates once for all of them.
+ *
+ * The assumption is pushed even if it contradicts the puzzle, so every call
+ * that returns true or false is undone by exactly one retract().
+ *
+ * @param assumptions The stack of assumptions.
+ * @param values The puzzle holding the values of the cells.
+ * @param cells The cells to be fixed, as bits in the grid.
+ *
+ * @return true if the puzzle is still consistent, false otherwise or if the
+ *         stack is full (in which case nothing is pushed).
+ */
+bool assumeClues(Assumptions* assumptions, const Puzzle* values, unsigned long long cells)
+{
+    if (assumptions->depth == MAX_ASSUMPTIONS) { return false; }
+
+    Puzzle puzzle = assumptions->stack[assumptions->depth];
+    bool consistent = assumptions->consistent[assumptions->depth];
+    unsigned long long filled = cells & ~puzzle.actions;
+    unsigned long long added = cells & puzzle.actions;
+
+    if ((puzzle.grid ^ values->grid) & filled) { consistent = false; }
+    if (added && consistent)
+    {
+        puzzle.actions &= ~added;
+        puzzle.grid = (puzzle.grid & ~added) | (values->grid & added);
+        consistent = propagate(&puzzle);
+    }
+
+    assumptions->depth++;
+    assumptions->stack[assumptions->depth] = puzzle;
+    assumptions->consistent[assumptions->depth] = consistent;
+    return consistent;
+}
+
+/**
+ * @brief Temporarily fixes a cell to a value and propagates.
+ *
+ * @param assumptions The stack of assumptions.
+ * @param cell The index of the cell, as a bit in the grid.
+ * @param value The value the cell is assumed to have.
+ *
+ * @return See assumeClues().
+ */
+bool assume(Assumptions* assumptions, int cell, bool value)
+{
+    Puzzle values = { .grid = (unsigned long long)value << cell };
+    return assumeClues(assumptions, &values, 1ULL << cell);
+}
+
+/**
+ * @brief Undoes the most recent assumption.
+ */
+void retract(Assumptions* assumptions)
+{
+    if (assumptions->depth > 0) { assumptions->depth--; }
+}
+
+/**
+ * @brief Returns the propagated puzzle under the current assumptions.
+ */
+const Puzzle* getAssumed(const Assumptions* assumptions)
+{
+    return &assumptions->stack[assumptions->depth];
+}
+
+/**
+ * @brief Tells whether the current assumptions are consistent so far, i.e.
+ *        propagation found no contradiction.
+ */
+bool isConsistent(const Assumptions* assumptions)
+{
+    return assumptions->consistent[assumptions->depth];
+}
+
+/**
+ * @brief Counts the solutions of the puzzle under the current assumptions.
+ *
+ * @param assumptions The stack of assumptions.
+ * @param limit The number of solutions after which to stop.
+ * @param solution Receives the first solution found, may be NULL.
+ *
+ * @return The number of solutions found, at most limit.
+ */
+unsigned long long countUnder(const Assumptions* assumptions, unsigned long long limit, Puzzle* solution)
+{
+    if (!assumptions->consistent[assumptions->depth]) { return 0; }
+    return countSolutions(assumptions->stack[assumptions->depth], limit, solution);
+}
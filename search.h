@@ -0,0 +1,27 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "takuzu.h"
+
+#define MAX_ASSUMPTIONS 128
+#define CONFLICT_NODES 100000
+
+typedef struct
+{
+    Puzzle stack[MAX_ASSUMPTIONS + 1];
+    bool consistent[MAX_ASSUMPTIONS + 1];
+    int depth;
+} Assumptions;
+
+bool propagate(Puzzle* puzzle);
+unsigned long long countSolutions(Puzzle puzzle, unsigned long long limit, Puzzle* solution);
+Puzzle getConflict(const Puzzle* puzzle, unsigned long long max_nodes, bool* exact);
+void initAssumptions(Assumptions* assumptions, const Puzzle* base);
+bool assumeClues(Assumptions* assumptions, const Puzzle* values, unsigned long long cells);
+bool assume(Assumptions* assumptions, int cell, bool value);
+void retract(Assumptions* assumptions);
+const Puzzle* getAssumed(const Assumptions* assumptions);
+bool isConsistent(const Assumptions* assumptions);
+unsigned long long countUnder(const Assumptions* assumptions, unsigned long long limit, Puzzle* solution);
+
+#endif
@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <unistd.h>
+#include "shard.h"
+#include "enumerate.h"
+
+
+typedef struct
+{
+    const Puzzle* puzzle;
+    const Shard* shard;
+    FILE* output;
+    const char* checkpoint_path;
+    unsigned long long prefix;
+    unsigned long long next;
+    unsigned long long solutions;
+    bool failed;
+} Job;
+
+/**
+ * The job a checkpoint belongs to: the puzzle, its markers and how the
+ * search is split. A checkpoint is only resumed by the same job, since the
+ * prefix indices and the output offset mean nothing to any other.
+ */
+typedef struct
+{
+    unsigned long long id;
+    unsigned long long edges[4];
+    unsigned prefix_rows;
+    int index;
+    int count;
+    int canonical;
+} JobKey;
+
+static JobKey getJobKey(const Job* job)
+{
+    const Puzzle* puzzle = job->puzzle;
+    return (JobKey) {
+        .id = getPuzzleId(puzzle),
+        .edges = { puzzle->across_equal, puzzle->across_opposite, puzzle->down_equal, puzzle->down_opposite },
+        .prefix_rows = job->shard->prefix_rows,
+        .index = job->shard->index,
+        .count = job->shard->count,
+        .canonical = job->shard->canonical
+    };
+}
+
+/**
+ * @brief Reads the progress of a shard from its checkpoint, if any.
+ *
+ * A checkpoint holds the index of the first prefix that is not done yet,
+ * the length of the output up to and including that prefix's predecessor
+ * and the number of solutions written so far, followed by the JobKey.
+ *
+ * @param job The job, whose progress is updated in place.
+ * @param offset Receives the length of the output.
+ * @param matches Set to whether the checkpoint could be parsed and belongs
+ *                to the job.
+ *
+ * @return true if there is a checkpoint, false otherwise.
+ */
+static bool loadCheckpoint(Job* job, long* offset, bool* matches)
+{
+    FILE* file = fopen(job->checkpoint_path, "r");
+    if (!file) { return false; }
+
+    JobKey expected = getJobKey(job);
+    JobKey key;
+    bool loaded = fscanf(file, "%llu %ld %llu %llx %llx %llx %llx %llx %u %d %d %d",
+        &job->next, offset, &job->solutions, &key.id, &key.edges[0], &key.edges[1], &key.edges[2], &key.edges[3],
+        &key.prefix_rows, &key.index, &key.count, &key.canonical) == 12;
+    fclose(file);
+
+    *matches = loaded && key.id == expected.id && key.prefix_rows == expected.prefix_rows &&
+        key.index == expected.index && key.count == expected.count && key.canonical == expected.canonical;
+    for (int i = 0; i < 4 && *matches; i++) { *matches = key.edges[i] == expected.edges[i]; }
+    return true;
+}
+
+/**
+ * @brief Makes the output durable and records that all prefixes before next
+ *        are done.
+ *
+ * The checkpoint is written to a temporary file that replaces the old one
+ * with rename(), so a crash leaves either the old or the new checkpoint.
+ */
+static bool saveCheckpoint(Job* job, unsigned long long next)
+{
+    char path[4096];
+    if (snprintf(path, sizeof(path), "%s.tmp", job->checkpoint_path) >= sizeof(path)) { return false; }
+
+    if (fflush(job->output) || fsync(fileno(job->output))) { return false; }
+    long offset = ftell(job->output);
+
+    FILE* file = fopen(path, "w");
+    if (!file) { return false; }
+
+    JobKey key = getJobKey(job);
+    bool saved = fprintf(file, "%llu %ld %llu %llx %llx %llx %llx %llx %u %d %d %d\n",
+        next, offset, job->solutions, key.id, key.edges[0], key.edges[1], key.edges[2], key.edges[3],
+        key.prefix_rows, key.index, key.count, key.canonical) > 0;
+    saved = !fflush(file) && !fsync(fileno(file)) && saved;
+    saved = !fclose(file) && saved;
+    return saved && !rename(path, job->checkpoint_path);
+}
+
+static bool writeSolution(const Solution* solution, void* context)
+{
+    Job* job = context;
+    char puzzleString[MAX_PUZZLE_STRING];
+
+    formatPuzzle(&solution->grid, puzzleString);
+    return fprintf(job->output, "%s %d\n", puzzleString, solution->orbit) > 0;
+}
+
+/**
+ * @brief Enumerates the completions of a prefix if it belongs to the shard.
+ *
+ * Prefixes are dealt out round robin by their index, so every shard gets a
+ * similar share of the search, and prefixes finished before a restart are
+ * skipped.
+ */
+static bool runPrefix(const Solution* prefix, void* context)
+{
+    Job* job = context;
+    const Shard* shard = job->shard;
+    unsigned long long index = job->prefix++;
+
+    if (index % shard->count != shard->index || index < job->next) { return true; }
+
+    job->solutions += enumerateFrom(job->puzzle, &prefix->grid, shard->prefix_rows, shard->canonical, writeSolution, job);
+    if (ferror(job->output) || !saveCheckpoint(job, index + 1))
+    {
+        job->failed = true;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Runs one shard of the enumeration of a puzzle's solutions.
+ *
+ * The search is split into the prefixes of enumeratePrefixes(), and this
+ * shard enumerates the completions of every count-th prefix, starting at
+ * index. Solutions are appended to the output as puzzle strings followed by
+ * their orbit. After every prefix the output is flushed to disk and a
+ * checkpoint is saved; when the shard is started again with an existing
+ * checkpoint, the output is truncated to the length recorded in it and the
+ * enumeration continues with the next prefix, so no solution is written
+ * twice. Shards are independent and can run in separate processes.
+ *
+ * The checkpoint records the puzzle and the shard it was written for, and
+ * a checkpoint of another job is refused without touching the output.
+ *
+ * @param puzzle The puzzle whose solutions are enumerated.
+ * @param shard Which part of the search to run and how to split it.
+ * @param outputPath The file the solutions are written to.
+ * @param checkpointPath The file the progress is recorded in.
+ *
+ * @return SHARD_DONE once the shard is complete, SHARD_IO_ERROR on an I/O
+ *         error and SHARD_MISMATCH if the checkpoint belongs to another job.
+ */
+ShardResult runShard(const Puzzle* puzzle, const Shard* shard, const char* outputPath, const char* checkpointPath)
+{
+    Job job = {
+        .puzzle = puzzle,
+        .shard = shard,
+        .checkpoint_path = checkpointPath,
+        .prefix = 0,
+        .next = 0,
+        .solutions = 0,
+        .failed = false
+    };
+    long offset = 0;
+    bool matches = false;
+
+    if (loadCheckpoint(&job, &offset, &matches))
+    {
+        if (!matches) { return SHARD_MISMATCH; }
+        job.output = fopen(outputPath, "r+");
+        if (!job.output) { return SHARD_IO_ERROR; }
+        if (ftruncate(fileno(job.output), offset) || fseek(job.output, offset, SEEK_SET))
+        {
+            fclose(job.output);
+            return SHARD_IO_ERROR;
+        }
+    }
+    else
+    {
+        job.output = fopen(outputPath, "w");
+        if (!job.output) { return SHARD_IO_ERROR; }
+    }
+
+    enumeratePrefixes(puzzle, shard->prefix_rows, shard->canonical, runPrefix, &job);
+
+    bool complete = !job.failed && saveCheckpoint(&job, job.prefix);
+    return !fclose(job.output) && complete ? SHARD_DONE : SHARD_IO_ERROR;
+}
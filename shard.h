@@ -0,0 +1,23 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include "takuzu.h"
+
+typedef struct
+{
+    unsigned prefix_rows;
+    int index;
+    int count;
+    bool canonical;
+} Shard;
+
+typedef enum
+{
+    SHARD_DONE,
+    SHARD_IO_ERROR,
+    SHARD_MISMATCH
+} ShardResult;
+
+ShardResult runShard(const Puzzle* puzzle, const Shard* shard, const char* outputPath, const char* checkpointPath);
+
+#endif
@@ -0,0 +1,436 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "store.h"
+
+#define STORE_MAGIC 0x535A4B54U
+#define STORE_BLOCK 256
+
+
+/**
+ * A store file starts with a header, followed by the blocks of keys and the
+ * index of the blocks. Keys are sorted and unique. Each block holds up to
+ * STORE_BLOCK keys, front coded: a key is written as the number of leading
+ * bytes it shares with the previous key, followed by its remaining bytes,
+ * most significant first. The first key of a block shares nothing, so every
+ * block can be decoded on its own.
+ */
+typedef struct
+{
+    unsigned magic;
+    unsigned size;
+    unsigned long long count;
+    unsigned long long blocks;
+    unsigned long long index_offset;
+} StoreHeader;
+
+typedef struct
+{
+    unsigned long long first;
+    unsigned long long offset;
+} StoreBlock;
+
+struct StoreWriter
+{
+    char path[4096];
+    unsigned size;
+    unsigned long long* keys;
+    size_t capacity;
+    size_t count;
+    int runs;
+};
+
+struct StoreReader
+{
+    int fd;
+    size_t length;
+    const unsigned char* data;
+    const StoreHeader* header;
+    const StoreBlock* index;
+};
+
+typedef struct
+{
+    FILE* file;
+    StoreHeader header;
+    StoreBlock* index;
+    unsigned long long previous;
+    unsigned long long offset;
+    unsigned long long in_block;
+} Encoder;
+
+typedef struct
+{
+    FILE* file;
+    unsigned long long key;
+} Run;
+
+/**
+ * @brief Turns a grid into its sort key.
+ *
+ * Row 0 goes into the most significant bits, so sorting keys as integers
+ * sorts grids like comparePuzzles() does and the grids that start with the
+ * same rows form a range of keys.
+ */
+static unsigned long long getKey(const Puzzle* grid)
+{
+    unsigned long long key = 0;
+    for (unsigned k = 0; k < grid->size; k++)
+    {
+        key = key << grid->size | getRow(grid, k).grid;
+    }
+    return key;
+}
+
+static Puzzle getGrid(unsigned long long key, unsigned size)
+{
+    Puzzle grid = { .grid = 0, .actions = 0, .size = size };
+    for (unsigned k = size; k-- > 0;)
+    {
+        grid.grid |= (key & ((1ULL << size) - 1)) << k * size;
+        key >>= size;
+    }
+    return grid;
+}
+
+static int compareKeys(const void* a, const void* b)
+{
+    unsigned long long key_a = *(const unsigned long long*) a;
+    unsigned long long key_b = *(const unsigned long long*) b;
+    return (key_a > key_b) - (key_a < key_b);
+}
+
+static void getRunPath(const StoreWriter* writer, int run, char* path, size_t length)
+{
+    snprintf(path, length, "%s.run%d", writer->path, run);
+}
+
+/**
+ * @brief Starts writing a store.
+ *
+ * Grids are collected in memory, up to the given number of bytes. Each time
+ * the buffer is full it is sorted and written to a temporary run file next
+ * to the store, and closeStoreWriter() merges the runs.
+ *
+ * @param path The file the store is written to.
+ * @param size The size of the grids, at most 8.
+ * @param memory The number of bytes to buffer grids in.
+ *
+ * @return The writer, or NULL if memory ran out.
+ */
+StoreWriter* createStoreWriter(const char* path, unsigned size, size_t memory)
+{
+    StoreWriter* writer = calloc(1, sizeof(StoreWriter));
+    if (!writer || strlen(path) + 16 > sizeof(writer->path) || size > 8)
+    {
+        free(writer);
+        return NULL;
+    }
+
+    strcpy(writer->path, path);
+    writer->size = size;
+    writer->capacity = memory / sizeof(unsigned long long) ? memory / sizeof(unsigned long long) : 1;
+    writer->keys = malloc(writer->capacity * sizeof(unsigned long long));
+    if (!writer->keys)
+    {
+        free(writer);
+        return NULL;
+    }
+    return writer;
+}
+
+static bool flushRun(StoreWriter* writer)
+{
+    char path[4096 + 16];
+    getRunPath(writer, writer->runs, path, sizeof(path));
+
+    FILE* file = fopen(path, "wb");
+    if (!file) { return false; }
+
+    qsort(writer->keys, writer->count, sizeof(unsigned long long), compareKeys);
+    bool written = fwrite(writer->keys, sizeof(unsigned long long), writer->count, file) == writer->count;
+    written = !fclose(file) && written;
+
+    writer->runs++;
+    writer->count = 0;
+    return written;
+}
+
+/**
+ * @brief Adds a complete grid to the store.
+ *
+ * @return false if a run could not be written.
+ */
+bool addToStore(StoreWriter* writer, const Puzzle* grid)
+{
+    if (writer->count == writer->capacity && !flushRun(writer)) { return false; }
+    writer->keys[writer->count++] = getKey(grid);
+    return true;
+}
+
+static bool encodeKey(Encoder* encoder, unsigned long long key)
+{
+    if (encoder->header.count && key == encoder->previous) { return true; }
+
+    unsigned char bytes[9];
+    int shared = 0;
+
+    if (encoder->in_block == STORE_BLOCK || !encoder->header.count)
+    {
+        StoreBlock* index = realloc(encoder->index, (encoder->header.blocks + 1) * sizeof(StoreBlock));
+        if (!index) { return false; }
+
+        encoder->index = index;
+        encoder->index[encoder->header.blocks++] = (StoreBlock) { .first = key, .offset = encoder->offset };
+        encoder->in_block = 0;
+    }
+    else
+    {
+        while (shared < 7 && (key ^ encoder->previous) >> (56 - 8 * shared) == 0) { shared++; }
+    }
+
+    bytes[0] = shared;
+    for (int i = shared; i < 8; i++) { bytes[1 + i - shared] = key >> (56 - 8 * i); }
+    if (fwrite(bytes, 1, 9 - shared, encoder->file) != 9 - shared) { return false; }
+
+    encoder->offset += 9 - shared;
+    encoder->previous = key;
+    encoder->header.count++;
+    encoder->in_block++;
+    return true;
+}
+
+/**
+ * @brief Merges the sorted runs into the store.
+ *
+ * The runs are merged by repeatedly taking the smallest head among them;
+ * every key is read and written once, so the merge needs one buffer per run
+ * regardless of the size of the store.
+ */
+static bool mergeRuns(StoreWriter* writer, Encoder* encoder)
+{
+    Run* runs = calloc(writer->runs ? writer->runs : 1, sizeof(Run));
+    bool merged = runs != NULL;
+    int open = 0;
+
+    for (int i = 0; i < writer->runs && merged; i++)
+    {
+        char path[4096 + 16];
+        getRunPath(writer, i, path, sizeof(path));
+        runs[i].file = fopen(path, "rb");
+        merged = runs[i].file != NULL;
+        if (merged && fread(&runs[i].key, sizeof(unsigned long long), 1, runs[i].file) == 1) { open++; }
+        else if (merged) { fclose(runs[i].file); runs[i].file = NULL; }
+    }
+
+    while (merged && open)
+    {
+        int smallest = -1;
+        for (int i = 0; i < writer->runs; i++)
+        {
+            if (runs[i].file && (smallest < 0 || runs[i].key < runs[smallest].key)) { smallest = i; }
+        }
+
+        merged = encodeKey(encoder, runs[smallest].key);
+        if (fread(&runs[smallest].key, sizeof(unsigned long long), 1, runs[smallest].file) != 1)
+        {
+            fclose(runs[smallest].file);
+            runs[smallest].file = NULL;
+            open--;
+        }
+    }
+
+    for (int i = 0; i < writer->runs && runs; i++)
+    {
+        if (runs[i].file) { fclose(runs[i].file); }
+    }
+    free(runs);
+    return merged;
+}
+
+static void removeRuns(const StoreWriter* writer)
+{
+    for (int i = 0; i < writer->runs; i++)
+    {
+        char path[4096 + 16];
+        getRunPath(writer, i, path, sizeof(path));
+        remove(path);
+    }
+}
+
+/**
+ * @brief Frees the writer without writing the store, e.g. after bad input.
+ *
+ * The temporary runs are removed and the file at the store's path, if any,
+ * is left as it was.
+ */
+void discardStoreWriter(StoreWriter* writer)
+{
+    removeRuns(writer);
+    free(writer->keys);
+    free(writer);
+}
+
+/**
+ * @brief Sorts everything added so far into the store and frees the writer.
+ *
+ * @return true if the store was written, false on an I/O error.
+ */
+bool closeStoreWriter(StoreWriter* writer)
+{
+    Encoder encoder = { .header = { .magic = STORE_MAGIC, .size = writer->size } };
+    encoder.offset = sizeof(StoreHeader);
+
+    bool written = !writer->count || flushRun(writer);
+    encoder.file = written ? fopen(writer->path, "wb") : NULL;
+    written = encoder.file && fseek(encoder.file, sizeof(StoreHeader), SEEK_SET) == 0;
+    written = written && mergeRuns(writer, &encoder);
+
+    while (written && encoder.offset % sizeof(StoreBlock))
+    {
+        written = fputc(0, encoder.file) != EOF;
+        encoder.offset++;
+    }
+
+    if (written)
+    {
+        encoder.header.index_offset = encoder.offset;
+        written = fwrite(encoder.index, sizeof(StoreBlock), encoder.header.blocks, encoder.file) == encoder.header.blocks;
+        written = written && !fseek(encoder.file, 0, SEEK_SET);
+        written = written && fwrite(&encoder.header, sizeof(StoreHeader), 1, encoder.file) == 1;
+    }
+
+    removeRuns(writer);
+    if (encoder.file) { written = !fclose(encoder.file) && written; }
+    free(encoder.index);
+    free(writer->keys);
+    free(writer);
+    return written;
+}
+
+/**
+ * @brief Opens a store for lookups.
+ *
+ * The file is mapped into memory, so lookups only touch the pages of the
+ * index and of the blocks they decode.
+ *
+ * @return The reader, or NULL if the file is missing or not a store.
+ */
+StoreReader* openStore(const char* path)
+{
+    StoreReader* reader = calloc(1, sizeof(StoreReader));
+    struct stat status;
+
+    if (!reader) { return NULL; }
+    reader->fd = open(path, O_RDONLY);
+    if (reader->fd < 0 || fstat(reader->fd, &status) || status.st_size < (off_t) sizeof(StoreHeader))
+    {
+        if (reader->fd >= 0) { close(reader->fd); }
+        free(reader);
+        return NULL;
+    }
+
+    reader->length = status.st_size;
+    void* data = mmap(NULL, reader->length, PROT_READ, MAP_SHARED, reader->fd, 0);
+    if (data == MAP_FAILED)
+    {
+        close(reader->fd);
+        free(reader);
+        return NULL;
+    }
+
+    reader->data = data;
+    reader->header = data;
+    reader->index = (const StoreBlock*) (reader->data + reader->header->index_offset);
+    if (reader->header->magic != STORE_MAGIC || !reader->header->size || reader->header->size > 8 ||
+        reader->header->index_offset + reader->header->blocks * sizeof(StoreBlock) > reader->length)
+    {
+        closeStore(reader);
+        return NULL;
+    }
+    return reader;
+}
+
+void closeStore(StoreReader* reader)
+{
+    munmap((void*) reader->data, reader->length);
+    close(reader->fd);
+    free(reader);
+}
+
+unsigned long long countStore(const StoreReader* reader)
+{
+    return reader->header->count;
+}
+
+unsigned getStoreSize(const StoreReader* reader)
+{
+    return reader->header->size;
+}
+
+/**
+ * @brief Looks up the grids in a store that start with the given rows.
+ *
+ * The grids that start with the rows form the range of keys between the key
+ * of the prefix with all later bits 0 and with all later bits 1. The index
+ * is binary searched for the last block starting at or before the range,
+ * after which blocks are decoded until the range is passed.
+ *
+ * @param reader The store to search.
+ * @param prefix A grid whose first rows are to be matched.
+ * @param rows The number of rows to match, 0 to visit the whole store.
+ * @param callback Called for each grid found, returns false to stop. May be
+ *                 NULL to only count.
+ * @param context Passed on to the callback.
+ *
+ * @return The number of grids visited.
+ */
+unsigned long long findPrefix(const StoreReader* reader, const Puzzle* prefix, unsigned rows, GridCallback callback, void* context)
+{
+    const StoreHeader* header = reader->header;
+    unsigned size = header->size;
+    unsigned long long low = 0;
+    unsigned long long found = 0;
+
+    for (unsigned k = 0; k < rows; k++) { low |= getRow(prefix, k).grid << (size - 1 - k) * size; }
+    unsigned free_bits = (size - rows) * size;
+    unsigned long long high = low | (free_bits < 64 ? (1ULL << free_bits) - 1 : -1ULL);
+
+    unsigned long long first = 0;
+    unsigned long long last = header->blocks;
+    while (last - first > 1)
+    {
+        unsigned long long middle = (first + last) / 2;
+        if (reader->index[middle].first <= low) { first = middle; }
+        else { last = middle; }
+    }
+
+    for (unsigned long long block = first; block < header->blocks; block++)
+    {
+        const unsigned char* bytes = reader->data + reader->index[block].offset;
+        unsigned long long entries = header->count - block * STORE_BLOCK;
+        unsigned long long key = 0;
+
+        if (reader->index[block].first > high) { break; }
+        if (entries > STORE_BLOCK) { entries = STORE_BLOCK; }
+
+        for (unsigned long long i = 0; i < entries; i++)
+        {
+            int shared = *bytes++;
+            key &= shared ? ~0ULL << (64 - 8 * shared) : 0;
+            for (int j = shared; j < 8; j++) { key |= (unsigned long long) *bytes++ << (56 - 8 * j); }
+
+            if (key > high) { return found; }
+            if (key < low) { continue; }
+
+            Puzzle grid = getGrid(key, size);
+            found++;
+            if (callback && !callback(&grid, context)) { return found; }
+        }
+    }
+    return found;
+}
@@ -0,0 +1,21 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include <stddef.h>
+#include "takuzu.h"
+
+typedef struct StoreWriter StoreWriter;
+typedef struct StoreReader StoreReader;
+typedef bool (*GridCallback)(const Puzzle* grid, void* context);
+
+StoreWriter* createStoreWriter(const char* path, unsigned size, size_t memory);
+bool addToStore(StoreWriter* writer, const Puzzle* grid);
+bool closeStoreWriter(StoreWriter* writer);
+void discardStoreWriter(StoreWriter* writer);
+StoreReader* openStore(const char* path);
+void closeStore(StoreReader* reader);
+unsigned long long countStore(const StoreReader* reader);
+unsigned getStoreSize(const StoreReader* reader);
+unsigned long long findPrefix(const StoreReader* reader, const Puzzle* prefix, unsigned rows, GridCallback callback, void* context);
+
+#endif
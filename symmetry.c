@@ -0,0 +1,97 @@
+#include "symmetry.h"
+
+
+/**
+ * @brief Applies one of the 16 symmetries of Takuzu to a puzzle.
+ *
+ * The rules are invariant under the 8 rotations and reflections of the grid
+ * and under swapping 0's and 1's. Bit 0 of symmetry mirrors the columns,
+ * bit 1 mirrors the rows, bit 2 transposes the grid (after mirroring) and
+ * bit 3 complements every filled in cell. Symmetry 0 is the identity.
+ *
+ * @param puzzle The puzzle to be transformed.
+ * @param symmetry The index of the symmetry, 0 to SYMMETRIES-1.
+ *
+ * @return The transformed puzzle.
+ */
+Puzzle transformPuzzle(const Puzzle* puzzle, int symmetry)
+{
+    unsigned size = puzzle->size;
+    Puzzle image = { .grid = 0, .actions = 0, .size = size };
+
+    for (unsigned r = 0; r < size; r++)
+    {
+        for (unsigned c = 0; c < size; c++)
+        {
+            unsigned row = symmetry & 2 ? size-1 - r : r;
+            unsigned col = symmetry & 1 ? size-1 - c : c;
+            unsigned target = symmetry & 4 ? col * size + row : row * size + col;
+
+            image.grid |= (puzzle->grid >> (r * size + c) & 1ULL) << target;
+            image.actions |= (puzzle->actions >> (r * size + c) & 1ULL) << target;
+        }
+    }
+
+    if (symmetry & 8)
+    {
+        unsigned long long board = size*size < 64 ? (1ULL << size*size) - 1 : -1ULL;
+        image.grid ^= ~image.actions & board;
+    }
+    return image;
+}
+
+/**
+ * @brief Compares two puzzles of the same size row by row, row 0 first.
+ *
+ * Rows are compared by their grid as an integer, ties are broken by the
+ * empty cells, again row by row.
+ *
+ * @return A negative number, 0 or a positive number if a comes before, is
+ *         equal to or comes after b.
+ */
+int comparePuzzles(const Puzzle* a, const Puzzle* b)
+{
+    for (unsigned k = 0; k < a->size; k++)
+    {
+        unsigned long long row_a = getRow(a, k).grid;
+        unsigned long long row_b = getRow(b, k).grid;
+        if (row_a != row_b) { return row_a < row_b ? -1 : 1; }
+    }
+    for (unsigned k = 0; k < a->size; k++)
+    {
+        unsigned long long row_a = getRow(a, k).actions;
+        unsigned long long row_b = getRow(b, k).actions;
+        if (row_a != row_b) { return row_a < row_b ? -1 : 1; }
+    }
+    return 0;
+}
+
+/**
+ * @brief Computes the canonical form of a puzzle.
+ *
+ * The canonical form is the smallest of the 16 images of the puzzle under
+ * comparePuzzles(), so two puzzles are symmetric iff their canonical forms
+ * are equal.
+ *
+ * @param puzzle The puzzle to be canonicalised.
+ * @param orbit Receives the number of distinct images of the puzzle, i.e.
+ *              SYMMETRIES divided by the number of symmetries that leave it
+ *              unchanged. May be NULL.
+ *
+ * @return The canonical form of the puzzle.
+ */
+Puzzle getCanonical(const Puzzle* puzzle, int* orbit)
+{
+    Puzzle canonical = *puzzle;
+    int fixed = 0;
+
+    for (int symmetry = 0; symmetry < SYMMETRIES; symmetry++)
+    {
+        Puzzle image = transformPuzzle(puzzle, symmetry);
+        if (comparePuzzles(&image, &canonical) < 0) { canonical = image; }
+        if (!comparePuzzles(&image, puzzle)) { fixed++; }
+    }
+
+    if (orbit) { *orbit = SYMMETRIES / fixed; }
+    return canonical;
+}
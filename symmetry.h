@@ -0,0 +1,12 @@
+#ifndef SYMMETRY_H
+#define SYMMETRY_H
+
+#include "takuzu.h"
+
+#define SYMMETRIES 16
+
+Puzzle transformPuzzle(const Puzzle* puzzle, int symmetry);
+int comparePuzzles(const Puzzle* a, const Puzzle* b);
+Puzzle getCanonical(const Puzzle* puzzle, int* orbit);
+
+#endif
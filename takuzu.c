@@ -1,8 +1,90 @@
 #include <stdio.h>
 #include <math.h>
 #include "takuzu.h"
+#include "dispatch.h"
+#include "probes.h"
+#include "trace.h"
 
 
+/**
+ * The search is written once, in searchFrom(), with the trace switched on
+ * or off by a constant flag. solveFrom() and solveFromTraced() instantiate
+ * it for both values, so the plain solve() has neither the recording code
+ * nor, when the probes are compiled out, the puzzle id and node counter.
+ */
+#define COUNTED(traced) ((traced) || HAS_PROBES)
+
+static bool solveFrom(Puzzle puzzle, unsigned long long id, int depth, unsigned long long* nodes, Trace* trace);
+static bool solveFromTraced(Puzzle puzzle, unsigned long long id, int depth, unsigned long long* nodes, Trace* trace);
+
+/**
+ * @brief Tries a value for a cell during the search, see solve().
+ *
+ * Fires the branch probe, and the reject probe if isValid() turns the
+ * value down. If traced, both are recorded, the rejection with the rule
+ * that is broken.
+ *
+ * @return true if the puzzle with this value is valid, false otherwise.
+ */
+static inline __attribute__((always_inline)) bool tryValue(const Puzzle* puzzle, unsigned long long id, int depth,
+                     unsigned long long nodes, int cell, bool value, Trace* trace, const bool traced)
+{
+    PROBE5(branch, id, depth, nodes, cell, value);
+    if (traced) { recordTrace(trace, TRACE_ASSIGN, nodes, depth, cell, value); }
+    if (isValid(puzzle)) { return true; }
+
+    PROBE5(reject, id, depth, nodes, cell, value);
+    if (traced) { recordTrace(trace, TRACE_REJECT, nodes, depth, cell, getRejection(puzzle, cell) << 1 | value); }
+    return false;
+}
+
+/**
+ * @brief Recursively solves a Takuzu puzzle, see solve().
+ *
+ * @param puzzle The Takuzu puzzle to be solved, filled in place.
+ * @param id The id of the puzzle solve() was called with, for the probes.
+ * @param depth The number of cells filled in by the search so far.
+ * @param nodes The number of calls so far, updated in place if counted.
+ * @param trace The trace recorder, only used if traced.
+ * @param traced Whether to record the search, a constant at every call.
+ *
+ * @return true if a solution is found, false otherwise.
+ */
+static inline __attribute__((always_inline)) bool searchFrom(Puzzle* puzzle, unsigned long long id, int depth,
+                                                            unsigned long long* nodes, Trace* trace, const bool traced)
+{
+    bool (*next)(Puzzle, unsigned long long, int, unsigned long long*, Trace*) = traced ? solveFromTraced : solveFrom;
+
+    if (COUNTED(traced)) { ++*nodes; }
+    for (int i = 0; i < puzzle->size*getHeight(puzzle); i++)
+    {
+        if (!(puzzle->actions & 1ULL << i)) { continue; }
+
+        puzzle->actions ^= 1ULL << i;
+        if (tryValue(puzzle, id, depth, *nodes, i, false, trace, traced) && next(*puzzle, id, depth + 1, nodes, trace)) { return true; }
+
+        puzzle->grid |= 1ULL << i;
+        if (tryValue(puzzle, id, depth, *nodes, i, true, trace, traced) && next(*puzzle, id, depth + 1, nodes, trace)) { return true; }
+
+        PROBE3(backtrack, id, depth, *nodes);
+        if (traced) { recordTrace(trace, TRACE_BACKTRACK, *nodes, depth, 0, 0); }
+        return false;
+    }
+    if (traced) { recordTrace(trace, TRACE_SOLVED, *nodes, depth, 0, 0); }
+    printPuzzle(puzzle);
+    return true;
+}
+
+static bool solveFrom(Puzzle puzzle, unsigned long long id, int depth, unsigned long long* nodes, Trace* trace)
+{
+    return searchFrom(&puzzle, id, depth, nodes, trace, false);
+}
+
+static bool solveFromTraced(Puzzle puzzle, unsigned long long id, int depth, unsigned long long* nodes, Trace* trace)
+{
+    return searchFrom(&puzzle, id, depth, nodes, trace, true);
+}
+
 /**
  * @brief Recursively solves a Takuzu puzzle.
  * 
@@ -10,62 +92,108 @@
  * update actions). If the new grid is valid, solve it. If not, we fill in a 1.
  * If that also fails, the puzzle has no solution. If no empty cells remain,
  * the puzzle is solved and printed.
+ *
+ * The search fires the static probes of probes.h: solve_start and solve_end
+ * around it, branch for every value tried, reject for every value isValid()
+ * turns down and backtrack when both values of a cell fail. All of them
+ * carry the id of the puzzle (see getPuzzleId()), the depth and the number
+ * of nodes visited so far.
  * 
  * @param puzzle The Takuzu puzzle to be solved.
  * 
  * @return true if a solution is found, false otherwise.
  */
 bool solve(Puzzle puzzle)
-{   
-    for (int i = 0; i < puzzle.size*puzzle.size; i++)
-    {
-        if (!(puzzle.actions & 1ULL << i)) { continue; }
+{
+    unsigned long long id = COUNTED(false) ? getPuzzleId(&puzzle) : 0;
+    unsigned long long nodes = 0;
+
+    PROBE3(solve_start, id, puzzle.size, getHeight(&puzzle));
+    bool solved = solveFrom(puzzle, id, 0, &nodes, NULL);
+    PROBE3(solve_end, id, nodes, solved);
+    return solved;
+}
 
-        puzzle.actions ^= 1ULL << i; 
-        if (isValid(&puzzle) && solve(puzzle)) { return true; }
+/**
+ * @brief Solves a Takuzu puzzle like solve(), recording the search.
+ *
+ * Every value tried, every rejection with its reason, every backtrack and
+ * the solution go into the ring buffer of the trace, see trace.c. Without
+ * a trace this is solve(), which has no recording code at all.
+ *
+ * @param puzzle The Takuzu puzzle to be solved.
+ * @param trace The trace recorder, emptied first, or NULL.
+ *
+ * @return true if a solution is found, false otherwise.
+ */
+bool solveTraced(Puzzle puzzle, Trace* trace)
+{
+    if (!trace) { return solve(puzzle); }
 
-        puzzle.grid |= 1ULL << i;
-        if (isValid(&puzzle) && solve(puzzle)){ return true; }
+    unsigned long long id = getPuzzleId(&puzzle);
+    unsigned long long nodes = 0;
 
-        return false;
-    }
-    printPuzzle(&puzzle);
-    return true;
+    startTrace(trace, &puzzle);
+    PROBE3(solve_start, id, puzzle.size, getHeight(&puzzle));
+    bool solved = solveFromTraced(puzzle, id, 0, &nodes, trace);
+    PROBE3(solve_end, id, nodes, solved);
+    return solved;
 }
 
 /**
  * @brief Checks if the puzzle is valid or not.
  *
+ * Runs the kernel selected for the CPU at startup, see dispatch.c. All
+ * kernels give the same answers as isValidGeneric().
+ *
+ * @param puzzle The puzzle to be checked for validity.
+ *
+ * @return true if the puzzle is valid, false otherwise.
+ */
+bool isValid(const Puzzle* puzzle)
+{
+    return isValidKernel(puzzle);
+}
+
+/**
+ * @brief Checks if the puzzle is valid or not, on any CPU.
+ *
  * The puzzle is valid if it meets or can meet the following requirements:
  * - All rows and columns are balanced, i.e. contain as many 1's as 0's.
  * - No row or column has three adjacent cells with the same value.
  * - All rows and columns are unique. 
  *
+ * RULE_BALANCED, RULE_MAX_RUN and RULE_UNIQUE select variants of these rules
+ * at compile time; a rule that is switched off is folded away. The "=" and
+ * "x" markers of the edge variant are checked first, see meetsEdges().
+ *
  * The first two requirements are explained in their corresponding fuctions.
  * The uniqueness constraint is enforced by comparing each row and column
  * with all previously seen rows and columns. This is only done for rows
- * and columns that contain no empty cells.
+ * and columns that contain no empty cells. Rows and columns are checked in
+ * separate passes since a rectangular grid has more of one than the other.
  *
  * @param puzzle The puzzle to be checked for validity.
  *
  * @return true if the puzzle is valid, false otherwise.
  */
-bool isValid(const Puzzle* puzzle)
+bool isValidGeneric(const Puzzle* puzzle)
 {
-    unsigned char rows[puzzle->size];
-    unsigned char cols[puzzle->size];
+    if (!meetsEdges(puzzle)) { return false; }
+
+    unsigned height = getHeight(puzzle);
+    unsigned long long rows[height];
+    unsigned long long cols[puzzle->size];
     int rows_index = 0;
     int cols_index = 0; 
 
-    for (int i = 0; i < puzzle->size; i++)
+    for (int i = 0; i < height; i++)
     {   
         Puzzle row = getRow(puzzle, i);
-        Puzzle col = getCol(puzzle, i);
         
         if (!isBalanced(&row) || hasTriplets(&row)) { return false; }
-        if (!isBalanced(&col) || hasTriplets(&col)) { return false; }
 
-        if (!row.actions)
+        if (RULE_UNIQUE && !row.actions)
         {
             for (int j = 0; j < rows_index; j++)
             {
@@ -73,8 +201,15 @@ bool isValid(const Puzzle* puzzle)
             }
             rows[rows_index++] = row.grid;
         }
+    }
+
+    for (int i = 0; i < puzzle->size; i++)
+    {   
+        Puzzle col = getCol(puzzle, i);
+        
+        if (!isBalanced(&col) || hasTriplets(&col)) { return false; }
 
-        if (!col.actions)
+        if (RULE_UNIQUE && !col.actions)
         {
             for (int j = 0; j < cols_index; j++)
             {
@@ -86,15 +221,50 @@ bool isValid(const Puzzle* puzzle)
     return true;
 }
 
+/**
+ * @brief Checks the "=" and "x" markers between adjacent cells.
+ *
+ * Bit i of across_equal and across_opposite marks the edge between cell i
+ * and its neighbour i+1 in the same row, bit i of down_equal and
+ * down_opposite the edge between cell i and cell i+size in the next row.
+ * Shifting the grid by 1 or size lines every cell up with its neighbour, so
+ * XOR-ing the shifted grid with the grid gives the cells that differ from
+ * their neighbour, for the whole board at once. A marker is only violated
+ * if both of its cells are filled in.
+ *
+ * @param puzzle The puzzle whose markers are to be checked.
+ *
+ * @return true if no marker is violated, false otherwise.
+ */
+bool meetsEdges(const Puzzle* puzzle)
+{
+    unsigned long long filled = ~getEmpty(puzzle);
+    unsigned long long across = filled & filled >> 1;
+    unsigned long long down = filled & filled >> puzzle->size;
+    unsigned long long differ_across = puzzle->grid ^ puzzle->grid >> 1;
+    unsigned long long differ_down = puzzle->grid ^ puzzle->grid >> puzzle->size;
+
+    return !(across & (puzzle->across_equal & differ_across | puzzle->across_opposite & ~differ_across)) &&
+        !(down & (puzzle->down_equal & differ_down | puzzle->down_opposite & ~differ_down));
+}
+
+/**
+ * @brief Checks if the puzzle has any "=" or "x" markers.
+ */
+bool hasEdges(const Puzzle* puzzle)
+{
+    return (puzzle->across_equal | puzzle->across_opposite | puzzle->down_equal | puzzle->down_opposite) != 0;
+}
+
 /**
  * @brief Extracts the row at the specified index from the puzzle.
  *
  * The desired row is obtained by right shifting the relevant bits into the 
- * N least significant bits where N is size. The rest of the bits are discarded
- * with a bitmask.
+ * N least significant bits where N is size, the width of the grid. The rest of
+ * the bits are discarded with a bitmask.
  *
  * @param puzzle The puzzle from which to extract the row.
- * @param index The index of the row to retrieve (0 is bottom, N-1 is top).
+ * @param index The index of the row to retrieve (0 is bottom, height-1 is top).
  *
  * @return A Puzzle struct containing the extracted row, actions and size.
  */
@@ -112,7 +282,8 @@ Puzzle getRow(const Puzzle* puzzle, int index)
  *
  * The column is extracted for both the puzzle's grid and its actions.
  * The grid is first aligned with the least significant bit by adding index.
- * Then, we iterate through the column by right shifting an additional i*size.
+ * Then, we iterate through the column by right shifting an additional i*size
+ * for each of the height rows, so the column has height cells.
  * The current value of col is left shifted by 1 to make room for the next bit.
  * Lastly, bitwise OR that next bit with the least significant bit of the grid.
  *
@@ -123,9 +294,9 @@ Puzzle getRow(const Puzzle* puzzle, int index)
 */ 
 Puzzle getCol(const Puzzle* puzzle, int index)
 {
-    Puzzle col = { .grid = 0, .actions = 0, .size = puzzle->size };
+    Puzzle col = { .grid = 0, .actions = 0, .size = getHeight(puzzle) };
     
-    for (int i = 0; i < puzzle->size; i++)
+    for (int i = 0; i < col.size; i++)
     {
         col.grid = col.grid << 1 | puzzle->grid >> (index + i * puzzle->size) & 1ULL;
         col.actions = col.actions << 1 | puzzle->actions >> (index + i * puzzle->size) & 1ULL;
@@ -141,9 +312,12 @@ Puzzle getCol(const Puzzle* puzzle, int index)
  * @param rowOrCol The row or column to be checked for balance.
  *
  * @return true if there are no more than size/2 1's or 0's , false otherwise.
+ *         Always true if RULE_BALANCED is 0.
  */
 bool isBalanced(const Puzzle* rowOrCol)
 {
+    if (!RULE_BALANCED) { return true; }
+
     int count_0 = 0;
     int count_1 = 0;
     for (int i = 0; i < rowOrCol->size; i++)
@@ -159,10 +333,12 @@ bool isBalanced(const Puzzle* rowOrCol)
 /**
  * @brief Checks for three adjacent bits with the same value in a row or column.
  *
- * The bitmask 7U (or 00000111) extracts the three least significant bits.
- * Check if all three cells are non-empty using 'actions', if they are,
- * add one to the row or column because 111 + 1 = 000 and 000 + 1 = 001
- * so the result is <= 1 if the three least significant bits are equal.
+ * More generally, checks for a run of RULE_MAX_RUN+1 equal bits, which is
+ * three by default. The bitmask 7U (or 00000111) extracts the three least
+ * significant bits. Check if all three cells are non-empty using 'actions',
+ * if they are, shift them into the least significant bits and add one
+ * because 111 + 1 = 000 and 000 + 1 = 001 so the result is <= 1 if the three
+ * bits are equal. Longer runs use a wider mask in the same way.
  *
  * @param rowOrCol The row or column to be checked for triplets.
  *
@@ -170,39 +346,113 @@ bool isBalanced(const Puzzle* rowOrCol)
  */
 bool hasTriplets(const Puzzle* rowOrCol)
 {
-    for (int i = 0; i < rowOrCol->size-2; i++)
+    const unsigned long long run = (1ULL << (RULE_MAX_RUN + 1)) - 1;
+
+    for (int i = 0; i + RULE_MAX_RUN < rowOrCol->size; i++)
     {
-        if (!(rowOrCol->actions & 7ULL << i))
+        if (!(rowOrCol->actions & run << i))
         {
-            if ((rowOrCol->grid + 1 & 7ULL << i) <= 1) { return true; }
+            if (((rowOrCol->grid >> i) + 1 & run) <= 1) { return true; }
         }
     }
     return false;
 }
 
+/**
+ * @brief Returns the number of rows of the puzzle.
+ *
+ * A height of 0 means the grid is square, so puzzles built with only a size
+ * keep working. size is always the width, i.e. the length of a row.
+ *
+ * @param puzzle The puzzle whose height is wanted.
+ *
+ * @return The number of rows of the grid.
+ */
+unsigned getHeight(const Puzzle* puzzle)
+{
+    return puzzle->height ? puzzle->height : puzzle->size;
+}
+
+/**
+ * @brief Returns the empty cells of the puzzle.
+ *
+ * getPuzzle() starts with all 64 bits of 'actions' set, so the bits beyond
+ * size*height are masked out before 'actions' is used as a set of cells.
+ *
+ * @param puzzle The puzzle whose empty cells are wanted.
+ *
+ * @return A bitmask with a 1 for every empty cell of the grid.
+ */
+unsigned long long getEmpty(const Puzzle* puzzle)
+{
+    unsigned cells = puzzle->size*getHeight(puzzle);
+    return cells < 64 ? puzzle->actions & ((1ULL << cells) - 1) : puzzle->actions;
+}
+
+/**
+ * @brief Returns an id for the puzzle, e.g. to tell puzzles apart in traces.
+ *
+ * A hash of the dimensions and the clues, so the same puzzle gets the same
+ * id in every process. Edge markers are not part of it.
+ *
+ * @param puzzle The puzzle to be identified.
+ *
+ * @return The id of the puzzle.
+ */
+unsigned long long getPuzzleId(const Puzzle* puzzle)
+{
+    unsigned long long empty = getEmpty(puzzle);
+    unsigned long long hash = (puzzle->grid & ~empty) ^ empty * 0x9E3779B97F4A7C15ULL;
+    hash ^= (unsigned long long)puzzle->size << 40 | (unsigned long long)getHeight(puzzle) << 48;
+    hash = (hash ^ hash >> 30) * 0xBF58476D1CE4E5B9ULL;
+    hash = (hash ^ hash >> 27) * 0x94D049BB133111EBULL;
+    return hash ^ hash >> 31;
+}
+
+/**
+ * @brief Counts the filled in cells of the puzzle.
+ */
+int countClues(const Puzzle* puzzle)
+{
+    int clues = 0;
+    for (int i = 0; i < puzzle->size*getHeight(puzzle); i++)
+    {
+        if (!(puzzle->actions & 1ULL << i)) { clues++; }
+    }
+    return clues;
+}
+
 /**
  * @brief Prints out a nicely formatted version of the puzzle's grid.
  * 
- * Starts a new line every N cells where N is puzzle->size (but skip the first).
+ * Starts a new line every N cells where N is puzzle->size, the width of the
+ * grid (but skip the first).
  * If the cell is empty, prints a space, else prints the cell's value.
  * Prints a separator if it is not the last item in the row.
+ * Separators show the "=" and "x" markers of the edge variant, if any.
  * 
  * @param puzzle The puzzle to be printed.
  */
 void printPuzzle(const Puzzle* puzzle)
 {
-    for (int i = 0; i < puzzle->size*puzzle->size; i++)
+    for (int i = 0; i < puzzle->size*getHeight(puzzle); i++)
     {   
         if (i % puzzle->size == 0 && i)
         {
             printf("\n");
-            for (int j = 0; j < puzzle->size-1; j++) { printf("---+"); }
-            printf("---\n");
+            for (int j = i - puzzle->size; j < i; j++)
+            {
+                char marker = puzzle->down_equal >> j & 1ULL ? '=' : puzzle->down_opposite >> j & 1ULL ? 'x' : '-';
+                printf(j < i-1 ? "-%c-+" : "-%c-\n", marker);
+            }
         }
 
         printf(puzzle->actions >> i & 1ULL ? "   " : " %d ", puzzle->grid >> i & 1ULL);
 
-        if (i % puzzle->size != puzzle->size-1) { printf("|"); }
+        if (i % puzzle->size != puzzle->size-1)
+        {
+            printf("%c", puzzle->across_equal >> i & 1ULL ? '=' : puzzle->across_opposite >> i & 1ULL ? 'x' : '|');
+        }
     }
     printf("\n");
 }
@@ -213,6 +463,9 @@ void printPuzzle(const Puzzle* puzzle)
  * A valid Takuzu puzzle consists of only '0's and '1's and has a length of 16,
  * 36, or 64. Anything less than 16 renders the puzzle trivial, anything longer
  * than 64 and the puzzle no longer fits in an unsigned long long integer.
+ * Rectangular puzzles separate their rows with '/', e.g. 4 rows of 6 cells.
+ * All rows must have the same length, and the width and the height must both
+ * be even and at least 4, with at most 64 cells in total.
  * 
  * @param puzzleString The string representation of the puzzle to be validated.
  * 
@@ -221,9 +474,22 @@ void printPuzzle(const Puzzle* puzzle)
 bool validatePuzzleString(const char* puzzleString)
 {   
     int length = 0;
+    int width = 0;
+    int height = 1;
 
     while (*puzzleString)
     {
+        if (*puzzleString == '/')
+        {
+            if (width && length != width * height)
+            {
+                printf("Error: All rows must have the same length.\n");
+                return false;
+            }
+            width = length / height++;
+            puzzleString++;
+            continue;
+        }
         if (*puzzleString != '1' && *puzzleString != '0' && *puzzleString != ' ')
         {
             printf("Error: Invalid character found: %c.\n", *puzzleString);
@@ -234,7 +500,17 @@ bool validatePuzzleString(const char* puzzleString)
         length++;
     }
 
-    if (length != 16 && length != 36 && length != 64)
+    if (height > 1)
+    {
+        if (length != width * height || width % 2 || height % 2 || width < 4 || height < 4 || length > 64)
+        {
+            printf("Error: Invalid puzzle dimensions: %d rows of %d cells.\n", height, length / height);
+            printf("Rows must have the same even length, the number of rows must be even,\n");
+            printf("both must be at least 4 and the puzzle must have at most 64 cells.\n");
+            return false;
+        }
+    }
+    else if (length != 16 && length != 36 && length != 64)
     {
         printf("Error: Invalid puzzle length: %d.\n", length);
         printf("Puzzle length must be 16, 36 or 64.\n");
@@ -252,7 +528,9 @@ bool validatePuzzleString(const char* puzzleString)
  * is 64 bits so the max grid size is 8x8). Cells that are empty or are filled
  * in with a 0 cannot be distinguished from each other, so 'actions' keeps track
  * of which bits are empty. Initially, all cells are empty so all bits in 'grid'
- * are 0 and all bits in 'actions' are 1. Size represents the size of the grid.
+ * are 0 and all bits in 'actions' are 1. Size represents the width of the grid
+ * and height its number of rows, left 0 if the grid is square. Rows separated
+ * by '/' give a rectangular grid, otherwise the grid is square.
  * 
  * @param puzzleString The string representation of the puzzle to be parsed.
  * 
@@ -260,11 +538,18 @@ bool validatePuzzleString(const char* puzzleString)
  */
 Puzzle getPuzzle(const char* puzzleString)
 {
-    Puzzle puzzle = { .grid = 0, .actions = -1, .size = 0 };
+    Puzzle puzzle = { .grid = 0, .actions = -1, .size = 0, .height = 0 };
 
     unsigned length = 0;
+    unsigned rows = 1;
     while (*puzzleString)
     {   
+        if (*puzzleString == '/')
+        {
+            rows++;
+            puzzleString++;
+            continue;
+        }
         if (*puzzleString != ' ') { puzzle.actions ^= 1ULL << length; }
         if (*puzzleString == '1') { puzzle.grid |= 1ULL << length; }
 
@@ -272,6 +557,98 @@ Puzzle getPuzzle(const char* puzzleString)
         puzzleString++;
     }
 
-    puzzle.size = sqrt(length);
+    if (rows > 1)
+    {
+        puzzle.size = length / rows;
+        if (rows != puzzle.size) { puzzle.height = rows; }
+    }
+    else { puzzle.size = sqrt(length); }
     return puzzle;
 }
+
+/**
+ * @brief Validates the edge string of a puzzle of the edge variant.
+ *
+ * The edge string holds two characters per cell, in the order of the
+ * puzzle string: the marker to the right of the cell, then the marker below
+ * it. A marker is '=' if the cells are equal, 'x' if they are opposite and
+ * ' ' or '.' if there is none. The last column has no markers to its right
+ * and the last row none below it.
+ *
+ * @param puzzle The puzzle the edges belong to.
+ * @param edgeString The edge string to be validated.
+ *
+ * @return true if the edge string is valid, false otherwise.
+ */
+bool validateEdgeString(const Puzzle* puzzle, const char* edgeString)
+{
+    unsigned cells = puzzle->size*getHeight(puzzle);
+    unsigned length = 0;
+
+    for (; edgeString[length]; length++)
+    {
+        char marker = edgeString[length];
+        unsigned cell = length / 2;
+        if (marker != '=' && marker != 'x' && marker != ' ' && marker != '.')
+        {
+            printf("Error: Invalid marker found: %c.\n", marker);
+            printf("Markers are '=', 'x', and ' ' or '.' for none.\n");
+            return false;
+        }
+        if ((marker == '=' || marker == 'x') && cell < cells &&
+            (length % 2 ? cell >= cells - puzzle->size : cell % puzzle->size == puzzle->size-1))
+        {
+            printf("Error: Marker %c of cell %u points off the grid.\n", marker, cell);
+            return false;
+        }
+    }
+
+    if (length != 2 * cells)
+    {
+        printf("Error: Invalid edge string length: %u.\n", length);
+        printf("The edge string needs two markers per cell, %u in total.\n", 2 * cells);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Parses an edge string into the marker masks of a puzzle.
+ *
+ * See validateEdgeString() for the format.
+ *
+ * @param edgeString The edge string to be parsed.
+ * @param puzzle The puzzle whose markers are set.
+ */
+void getEdges(const char* edgeString, Puzzle* puzzle)
+{
+    puzzle->across_equal = puzzle->across_opposite = puzzle->down_equal = puzzle->down_opposite = 0;
+
+    for (unsigned i = 0; edgeString[2*i] && edgeString[2*i + 1]; i++)
+    {
+        if (edgeString[2*i] == '=') { puzzle->across_equal |= 1ULL << i; }
+        if (edgeString[2*i] == 'x') { puzzle->across_opposite |= 1ULL << i; }
+        if (edgeString[2*i + 1] == '=') { puzzle->down_equal |= 1ULL << i; }
+        if (edgeString[2*i + 1] == 'x') { puzzle->down_opposite |= 1ULL << i; }
+    }
+}
+
+/**
+ * @brief Writes the string representation of a Takuzu puzzle.
+ *
+ * The inverse of getPuzzle(): each cell becomes a '0', a '1' or a ' ' if it
+ * is empty, so the result can be passed back to getPuzzle(). The rows of a
+ * rectangular puzzle are separated by '/'.
+ *
+ * @param puzzle The puzzle to be written.
+ * @param puzzleString The output, with room for MAX_PUZZLE_STRING characters.
+ */
+void formatPuzzle(const Puzzle* puzzle, char* puzzleString)
+{
+    for (int i = 0; i < puzzle->size*getHeight(puzzle); i++)
+    {
+        if (puzzle->height && i && i % puzzle->size == 0) { *puzzleString++ = '/'; }
+        *puzzleString++ = puzzle->actions >> i & 1ULL ? ' ' : '0' + (puzzle->grid >> i & 1ULL);
+    }
+    *puzzleString = '\0';
+}
@@ -1,22 +1,56 @@
 #ifndef TAKUZU_H
 #define TAKUZU_H
 
+#define MAX_PUZZLE_STRING 80
+
+/* Rule variants, fixed at compile time (e.g. -DRULE_MAX_RUN=3) so that each
+ * variant gets kernels without runtime checks. The defaults are the
+ * standard rules. */
+#ifndef RULE_MAX_RUN
+#define RULE_MAX_RUN 2
+#endif
+#ifndef RULE_BALANCED
+#define RULE_BALANCED 1
+#endif
+#ifndef RULE_UNIQUE
+#define RULE_UNIQUE 1
+#endif
+#define STANDARD_RULES (RULE_MAX_RUN == 2 && RULE_BALANCED && RULE_UNIQUE)
+
 typedef enum { false, true } bool;
 typedef struct
 {
     unsigned long long grid;
     unsigned long long actions;
     unsigned size;
+    unsigned height;
+    unsigned long long across_equal;
+    unsigned long long across_opposite;
+    unsigned long long down_equal;
+    unsigned long long down_opposite;
 } Puzzle;
 
+typedef struct Trace Trace;
+
 bool solve(Puzzle puzzle);
+bool solveTraced(Puzzle puzzle, Trace* trace);
 bool isValid(const Puzzle* puzzle);
+bool isValidGeneric(const Puzzle* puzzle);
+bool meetsEdges(const Puzzle* puzzle);
+bool hasEdges(const Puzzle* puzzle);
 Puzzle getRow(const Puzzle* puzzle, int index);
 Puzzle getCol(const Puzzle* puzzle, int index);
 bool isBalanced(const Puzzle* rowOrCol);
 bool hasTriplets(const Puzzle* rowOrCol);
+unsigned getHeight(const Puzzle* puzzle);
+unsigned long long getEmpty(const Puzzle* puzzle);
+unsigned long long getPuzzleId(const Puzzle* puzzle);
+int countClues(const Puzzle* puzzle);
 void printPuzzle(const Puzzle* puzzle);
 bool validatePuzzleString(const char* puzzleString);
 Puzzle getPuzzle(const char* puzzleString);
+bool validateEdgeString(const Puzzle* puzzle, const char* edgeString);
+void getEdges(const char* edgeString, Puzzle* puzzle);
+void formatPuzzle(const Puzzle* puzzle, char* puzzleString);
 
 #endif
@@ -0,0 +1,1449 @@
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "takuzu.h"
+#include "batch.h"
+#include "catalog.h"
+#include "count.h"
+#include "dedup.h"
+#include "dispatch.h"
+#include "enumerate.h"
+#include "generate.h"
+#include "latency.h"
+#include "near.h"
+#include "search.h"
+#include "shard.h"
+#include "store.h"
+#include "symmetry.h"
+#include "trace.h"
+
+#define STORE_PATH "test_takuzu.store"
+#define CATALOG_PATH "test_takuzu.catalog"
+#define SHARD_PATH "test_takuzu.shard"
+#define CHECKPOINT_PATH "test_takuzu.shard.checkpoint"
+#define TRACE_PATH "test_takuzu.trace"
+#define OUTPUT_PATH "test_takuzu.out"
+#define SPILL_PATH "test_takuzu.spill"
+
+
+static int failures = 0;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++; \
+        } \
+    } while (0)
+
+static unsigned long long nextRandom(unsigned long long* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/**
+ * @brief Checks every kernel this CPU supports against isValidGeneric() on
+ *        random square and rectangular boards, with and without markers.
+ */
+static void testKernels(void)
+{
+    const unsigned dimensions[][2] = { { 4, 4 }, { 6, 6 }, { 8, 8 }, { 4, 6 }, { 6, 4 }, { 8, 6 }, { 4, 16 } };
+    CpuLevel detected = detectCpuLevel();
+    unsigned long long random = 0x9E3779B97F4A7C15ULL;
+
+    for (CpuLevel level = CPU_GENERIC; level <= detected; level++)
+    {
+        CHECK(forceCpuLevel(level));
+        unsigned long long mismatches = 0;
+
+        for (int i = 0; i < 200000; i++)
+        {
+            const unsigned* shape = dimensions[i % 7];
+            unsigned cells = shape[0] * shape[1];
+            unsigned long long mask = cells < 64 ? (1ULL << cells) - 1 : -1ULL;
+            unsigned long long empty = nextRandom(&random);
+            for (int sparse = i / 7 % 4; sparse > 0; sparse--) { empty &= nextRandom(&random); }
+
+            Puzzle puzzle = {
+                .grid = nextRandom(&random) & ~empty & mask,
+                .actions = empty & mask,
+                .size = shape[0],
+                .height = shape[1] == shape[0] ? 0 : shape[1]
+            };
+            if (i % 5 == 0)
+            {
+                puzzle.across_equal = nextRandom(&random) & nextRandom(&random) & nextRandom(&random) & mask;
+                puzzle.down_opposite = nextRandom(&random) & nextRandom(&random) & nextRandom(&random) & mask;
+                for (unsigned k = 0; k < shape[1]; k++) { puzzle.across_equal &= ~(1ULL << (k * shape[0] + shape[0] - 1)); }
+                puzzle.down_opposite &= mask >> shape[0];
+            }
+            mismatches += isValidKernel(&puzzle) != isValidGeneric(&puzzle);
+        }
+
+        if (mismatches) { printf("Kernel %s disagrees on %llu boards.\n", getCpuLevelName(level), mismatches); }
+        CHECK(!mismatches);
+    }
+    forceCpuLevel(detected);
+}
+
+/**
+ * @brief Checks the number of solutions of empty boards against the known
+ *        totals, by search, by counting and by ranking.
+ */
+static void testEmptyCounts(void)
+{
+    const unsigned long long totals[] = { 72, 4140, 4111116 };
+
+    for (int i = 0; i < 3; i++)
+    {
+        unsigned size = 4 + 2 * i;
+        Puzzle empty = { .grid = 0, .actions = -1, .size = size };
+
+        if (size < 8) { CHECK(countSolutions(empty, -1ULL, NULL) == totals[i]); }
+
+        Marginals marginals;
+        CHECK(countMarginals(&empty, &marginals));
+        CHECK(marginals.total == totals[i]);
+        CHECK(marginals.ones[0] * 2 == totals[i]);
+
+        Ranking* ranking = createRanking(size);
+        CHECK(ranking != NULL);
+        if (ranking) { CHECK(countGrids(ranking) == totals[i]); }
+        freeRanking(ranking);
+    }
+}
+
+/**
+ * @brief Checks that unranking gives distinct valid grids that rank back to
+ *        the same rank, for all 6x6 grids and a sample of 8x8 grids.
+ */
+static void testRanking(void)
+{
+    unsigned long long random = 12345;
+
+    for (unsigned size = 6; size <= 8; size += 2)
+    {
+        Ranking* ranking = createRanking(size);
+        CHECK(ranking != NULL);
+        if (!ranking) { continue; }
+
+        unsigned long long total = countGrids(ranking);
+        unsigned long long previous = 0;
+        for (unsigned long long i = 0; i < (size == 6 ? total : 20000); i++)
+        {
+            unsigned long long rank = size == 6 ? i : nextRandom(&random) % total;
+            Puzzle grid;
+            unsigned long long back = -1ULL;
+
+            CHECK(unrankGrid(ranking, rank, &grid));
+            CHECK(!getEmpty(&grid) && isValid(&grid));
+            CHECK(rankGrid(ranking, &grid, &back));
+            CHECK(back == rank);
+            if (size == 6 && i) { CHECK(grid.grid != previous); }
+            previous = grid.grid;
+        }
+
+        Puzzle grid;
+        CHECK(!unrankGrid(ranking, total, &grid));
+        freeRanking(ranking);
+    }
+}
+
+/**
+ * @brief Checks the markers of a puzzle one edge at a time: a marker is
+ *        broken if both of its cells are filled in and equal for an "x" or
+ *        different for an "=".
+ */
+static bool meetsEdgesReference(const Puzzle* puzzle)
+{
+    unsigned cells = puzzle->size * getHeight(puzzle);
+    unsigned long long empty = getEmpty(puzzle);
+    for (unsigned i = 0; i < cells; i++)
+    {
+        unsigned neighbours[2] = { i + 1, i + puzzle->size };
+        unsigned long long equal[2] = { puzzle->across_equal, puzzle->down_equal };
+        unsigned long long opposite[2] = { puzzle->across_opposite, puzzle->down_opposite };
+        for (int d = 0; d < 2; d++)
+        {
+            unsigned j = neighbours[d];
+            if (j >= cells || (d == 0 && i % puzzle->size == puzzle->size - 1)) { continue; }
+            if (empty >> i & 1 || empty >> j & 1) { continue; }
+
+            bool same = (puzzle->grid >> i & 1) == (puzzle->grid >> j & 1);
+            if (equal[d] >> i & 1 && !same) { return false; }
+            if (opposite[d] >> i & 1 && same) { return false; }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Checks puzzles with "=" and "x" markers against every grid of
+ *        their size: the solutions counted must be the grids that keep the
+ *        clues and meet the markers, for markers taken from a grid and for
+ *        random ones. meetsEdges() must agree with checking each marker on
+ *        partly filled grids, and an edge string must parse to its markers.
+ */
+static void testEdges(void)
+{
+    unsigned long long random = 6868;
+
+    for (unsigned size = 4; size <= 6; size += 2)
+    {
+        Ranking* ranking = createRanking(size);
+        CHECK(ranking != NULL);
+        if (!ranking) { continue; }
+
+        unsigned cells = size * size;
+        unsigned long long board = (1ULL << cells) - 1;
+        unsigned long long across = 0, down = board >> size;
+        for (unsigned i = 0; i < cells; i++) { across |= (unsigned long long)(i % size != size - 1) << i; }
+
+        for (int i = 0; i < 30; i++)
+        {
+            Puzzle grid;
+            unrankGrid(ranking, nextRandom(&random) % countGrids(ranking), &grid);
+
+            unsigned long long clues = nextRandom(&random) & nextRandom(&random) & nextRandom(&random) & board;
+            unsigned long long across_marked = nextRandom(&random) & nextRandom(&random) & across;
+            unsigned long long down_marked = nextRandom(&random) & nextRandom(&random) & down;
+            unsigned long long across_same = i % 3 ? ~(grid.grid ^ grid.grid >> 1) : nextRandom(&random);
+            unsigned long long down_same = i % 3 ? ~(grid.grid ^ grid.grid >> size) : nextRandom(&random);
+
+            Puzzle puzzle = {
+                .grid = grid.grid & clues, .actions = ~clues & board, .size = size,
+                .across_equal = across_marked & across_same, .across_opposite = across_marked & ~across_same,
+                .down_equal = down_marked & down_same, .down_opposite = down_marked & ~down_same
+            };
+
+            unsigned long long expected = 0;
+            for (unsigned long long rank = 0; rank < countGrids(ranking); rank++)
+            {
+                Puzzle candidate = puzzle;
+                unrankGrid(ranking, rank, &grid);
+                candidate.grid = grid.grid;
+                candidate.actions = 0;
+                expected += ((grid.grid ^ puzzle.grid) & clues) == 0 && meetsEdgesReference(&candidate);
+            }
+            CHECK(countSolutions(puzzle, -1ULL, NULL) == expected);
+
+            for (int j = 0; j < 20; j++)
+            {
+                Puzzle partial = puzzle;
+                partial.actions = nextRandom(&random) & board;
+                partial.grid = nextRandom(&random) & ~partial.actions;
+                CHECK(meetsEdges(&partial) == meetsEdgesReference(&partial));
+            }
+        }
+        freeRanking(ranking);
+    }
+
+    Puzzle puzzle = getPuzzle("                ");
+    CHECK(validateEdgeString(&puzzle, "=.xx.=.....xx=.................."));
+    getEdges("=.xx.=.....xx=..................", &puzzle);
+    CHECK(puzzle.across_equal == 1 && puzzle.across_opposite == 0x42 && puzzle.down_equal == 0x44 && puzzle.down_opposite == 0x22);
+}
+
+/**
+ * @brief Checks a full row or column the slow way: balanced and without
+ *        three equal cells in a row.
+ */
+static bool isLineValidReference(unsigned line, unsigned length)
+{
+    if ((unsigned)__builtin_popcount(line) != length / 2) { return false; }
+    for (unsigned i = 0; i + 2 < length; i++)
+    {
+        unsigned run = line >> i & 7;
+        if (run == 0 || run == 7) { return false; }
+    }
+    return true;
+}
+
+typedef struct
+{
+    unsigned width;
+    unsigned height;
+    unsigned rows[256];
+    int row_count;
+    unsigned long long valid;
+    bool agreed;
+} RectangleWalk;
+
+/**
+ * @brief Stacks valid rows into grids, skipping only those where a column
+ *        already has three equal cells in a row or too many of one value,
+ *        and checks isValid() on every full grid against checking the
+ *        columns and the uniqueness of lines the slow way.
+ */
+static void walkRectangles(RectangleWalk* walk, unsigned long long grid, unsigned depth)
+{
+    unsigned width = walk->width, height = walk->height;
+    if (depth == height)
+    {
+        bool expected = true;
+        unsigned cols[8];
+        for (unsigned r = 0; r < height; r++)
+        {
+            for (unsigned other = 0; other < r; other++) { expected = expected && (grid >> r * width ^ grid >> other * width) & ((1U << width) - 1); }
+        }
+        for (unsigned c = 0; c < width; c++)
+        {
+            cols[c] = 0;
+            for (unsigned r = 0; r < height; r++) { cols[c] |= (unsigned)(grid >> (r * width + c) & 1) << r; }
+            expected = expected && isLineValidReference(cols[c], height);
+            for (unsigned other = 0; other < c; other++) { expected = expected && cols[other] != cols[c]; }
+        }
+
+        Puzzle puzzle = { .grid = grid, .actions = 0, .size = width, .height = height };
+        walk->agreed = walk->agreed && isValid(&puzzle) == expected;
+        walk->valid += expected;
+        return;
+    }
+
+    for (int i = 0; i < walk->row_count; i++)
+    {
+        unsigned long long next = grid | (unsigned long long)walk->rows[i] << depth * width;
+        bool open = true;
+        for (unsigned c = 0; c < width && open; c++)
+        {
+            unsigned ones = 0;
+            for (unsigned r = 0; r <= depth; r++) { ones += next >> (r * width + c) & 1; }
+            open = 2 * ones <= height && 2 * (depth + 1 - ones) <= height;
+            if (depth >= 2)
+            {
+                unsigned run = (next >> (depth * width + c) & 1) | (next >> ((depth - 1) * width + c) & 1) << 1 | (next >> ((depth - 2) * width + c) & 1) << 2;
+                open = open && run != 0 && run != 7;
+            }
+        }
+        if (open) { walkRectangles(walk, next, depth + 1); }
+    }
+}
+
+/**
+ * @brief Checks isValid() on every grid of 4x6, 6x4, 6x8 and 8x6 cells made
+ *        of valid rows, and the number of valid grids against counting the
+ *        empty rectangle, see walkRectangles(). A rectangular puzzle string
+ *        must survive formatPuzzle() and solve to a valid grid.
+ */
+static void testRectangles(void)
+{
+    const unsigned shapes[][2] = { { 4, 6 }, { 6, 4 }, { 6, 8 }, { 8, 6 } };
+
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++)
+    {
+        RectangleWalk walk = { .width = shapes[s][0], .height = shapes[s][1], .row_count = 0, .valid = 0, .agreed = true };
+        for (unsigned line = 0; line < 1U << walk.width; line++)
+        {
+            if (isLineValidReference(line, walk.width)) { walk.rows[walk.row_count++] = line; }
+        }
+        walkRectangles(&walk, 0, 0);
+        CHECK(walk.agreed);
+        CHECK(walk.valid > 0);
+
+        Puzzle empty = { .grid = 0, .actions = (1ULL << walk.width * walk.height) - 1, .size = walk.width, .height = walk.height };
+        CHECK(countSolutions(empty, -1ULL, NULL) == walk.valid);
+    }
+
+    const char* puzzleString = "1    0/  1   /      /0    1";
+    char formatted[MAX_PUZZLE_STRING];
+    Puzzle puzzle = getPuzzle(puzzleString);
+    CHECK(puzzle.size == 6 && getHeight(&puzzle) == 4);
+    formatPuzzle(&puzzle, formatted);
+    CHECK(!strcmp(formatted, puzzleString));
+
+    Puzzle solution;
+    CHECK(countSolutions(puzzle, 1, &solution) == 1);
+    CHECK(getHeight(&solution) == 4 && !getEmpty(&solution) && isValid(&solution));
+    CHECK(((solution.grid ^ puzzle.grid) & ~getEmpty(&puzzle)) == 0);
+}
+
+/**
+ * @brief Checks the count of solutions without each clue against a search,
+ *        on random puzzles counted with one and with several threads.
+ */
+static void testWithoutClues(void)
+{
+    unsigned long long random = 4242;
+
+    for (unsigned size = 6; size <= 8; size += 2)
+    {
+        Ranking* ranking = createRanking(size);
+        CHECK(ranking != NULL);
+        if (!ranking) { continue; }
+
+        unsigned cells = size * size;
+        for (int i = 0; i < 4; i++)
+        {
+            Puzzle grid;
+            unrankGrid(ranking, nextRandom(&random) % countGrids(ranking), &grid);
+
+            unsigned long long clues = 0;
+            while (__builtin_popcountll(clues) < (size == 8 ? 24 : 8)) { clues |= 1ULL << nextRandom(&random) % cells; }
+            Puzzle puzzle = { .grid = grid.grid & clues, .actions = ~clues & (-1ULL >> (64 - cells)), .size = size };
+
+            for (int threads = 1; threads <= 3; threads += 2)
+            {
+                unsigned long long counts[64];
+                CHECK(countWithoutClues(&puzzle, counts, threads));
+                for (unsigned cell = 0; cell < cells; cell++)
+                {
+                    Puzzle without = puzzle;
+                    without.grid &= ~(1ULL << cell);
+                    without.actions |= 1ULL << cell;
+                    CHECK(counts[cell] == countSolutions(without, -1ULL, NULL));
+                }
+            }
+        }
+        freeRanking(ranking);
+    }
+
+    unsigned long long counts[64];
+    counts[0] = 1;
+    CHECK(!countWithoutClues(&(Puzzle) { .grid = 0, .actions = (1ULL << 48) - 1, .size = 8, .height = 6 }, counts, 1));
+    CHECK(counts[0] == 0);
+}
+
+/**
+ * @brief Checks counting under a stack of assumptions against counting the
+ *        puzzle with the assumed cells filled in, while pushing and
+ *        retracting single cells and sets of cells.
+ */
+static void testAssumptions(void)
+{
+    Ranking* ranking = createRanking(6);
+    unsigned long long random = 31337;
+    CHECK(ranking != NULL);
+    if (!ranking) { return; }
+
+    for (int i = 0; i < 20; i++)
+    {
+        Puzzle grid;
+        unrankGrid(ranking, nextRandom(&random) % countGrids(ranking), &grid);
+
+        unsigned long long clues = nextRandom(&random) & nextRandom(&random) & nextRandom(&random) & ((1ULL << 36) - 1);
+        Puzzle base = { .grid = grid.grid & clues, .actions = ~clues & ((1ULL << 36) - 1), .size = 6 };
+        Puzzle expected[8] = { base };
+        Assumptions assumptions;
+
+        initAssumptions(&assumptions, &base);
+        CHECK(countUnder(&assumptions, -1ULL, NULL) == countSolutions(base, -1ULL, NULL));
+
+        for (int depth = 1; depth < 8; depth++)
+        {
+            unsigned long long cells = 1ULL << nextRandom(&random) % 36;
+            if (depth % 3 == 0) { cells |= 1ULL << nextRandom(&random) % 36 | 1ULL << nextRandom(&random) % 36; }
+            Puzzle values = { .grid = depth % 2 ? grid.grid : nextRandom(&random) };
+
+            expected[depth] = expected[depth-1];
+            bool conflicting = ((expected[depth].grid ^ values.grid) & cells & ~expected[depth].actions) != 0;
+            expected[depth].actions &= ~cells;
+            expected[depth].grid = (expected[depth].grid & ~cells) | (values.grid & cells);
+            unsigned long long count = conflicting ? 0 : countSolutions(expected[depth], -1ULL, NULL);
+
+            int cell = __builtin_ctzll(cells);
+            bool consistent = depth % 3 ? assume(&assumptions, cell, values.grid >> cell & 1) : assumeClues(&assumptions, &values, cells);
+            CHECK(consistent || !count);
+            CHECK(countUnder(&assumptions, -1ULL, NULL) == count);
+            if (!count) { break; }
+        }
+
+        while (assumptions.depth > 0)
+        {
+            retract(&assumptions);
+            CHECK(countUnder(&assumptions, -1ULL, NULL) == countSolutions(expected[assumptions.depth], -1ULL, NULL));
+        }
+    }
+    freeRanking(ranking);
+}
+
+static bool samePuzzle(const Puzzle* a, const Puzzle* b)
+{
+    unsigned long long empty = getEmpty(a);
+    return a->size == b->size && getHeight(a) == getHeight(b) && empty == getEmpty(b) &&
+        ((a->grid ^ b->grid) & ~empty) == 0;
+}
+
+/**
+ * @brief Checks that drawBelow() stays below its bound, including bounds
+ *        that reject about half of the draws, and hits every value of a
+ *        small bound about equally often.
+ */
+static void testDrawBelow(void)
+{
+    const unsigned long long bounds[] = { 1, 2, 3, 7, 36, 4140, (1ULL << 63) + 1, -1ULL };
+    unsigned long long random = 99;
+
+    for (size_t i = 0; i < sizeof(bounds) / sizeof(bounds[0]); i++)
+    {
+        for (int j = 0; j < 1000; j++) { CHECK(drawBelow(&random, bounds[i]) < bounds[i]); }
+    }
+
+    int hits[7] = { 0 };
+    for (int j = 0; j < 7000; j++) { hits[drawBelow(&random, 7)]++; }
+    for (int j = 0; j < 7; j++) { CHECK(hits[j] > 850 && hits[j] < 1150); }
+}
+
+/**
+ * @brief Checks that the conflicts found in puzzles without solutions have
+ *        no solution themselves, are made of the puzzle's own clues and
+ *        become solvable when any one of their clues is removed. With too
+ *        few nodes, all clues are kept and the result is not exact.
+ */
+static void testConflict(void)
+{
+    Ranking* ranking = createRanking(6);
+    unsigned long long random = 4242;
+    int conflicts = 0;
+    CHECK(ranking != NULL);
+    if (!ranking) { return; }
+
+    for (int i = 0; i < 200 && conflicts < 20; i++)
+    {
+        Puzzle grid;
+        unrankGrid(ranking, nextRandom(&random) % countGrids(ranking), &grid);
+
+        unsigned long long clues = nextRandom(&random) & nextRandom(&random) & ((1ULL << 36) - 1);
+        if (!clues) { continue; }
+        Puzzle puzzle = { .grid = grid.grid & clues, .actions = ~clues & ((1ULL << 36) - 1), .size = 6 };
+        puzzle.grid ^= 1ULL << __builtin_ctzll(clues);
+        if (countSolutions(puzzle, 1, NULL)) { continue; }
+        conflicts++;
+
+        bool exact;
+        Puzzle conflict = getConflict(&puzzle, -1ULL, &exact);
+        unsigned long long kept = ~conflict.actions & ((1ULL << 36) - 1);
+        CHECK(exact);
+        CHECK(countSolutions(conflict, 1, NULL) == 0);
+        CHECK((kept & ~clues) == 0);
+        CHECK(((conflict.grid ^ puzzle.grid) & kept) == 0);
+
+        for (int cell = 0; cell < 36; cell++)
+        {
+            if (!(kept & 1ULL << cell)) { continue; }
+            Puzzle reduced = conflict;
+            reduced.actions |= 1ULL << cell;
+            reduced.grid &= ~(1ULL << cell);
+            CHECK(countSolutions(reduced, 1, NULL) == 1);
+        }
+
+        conflict = getConflict(&puzzle, 1, &exact);
+        CHECK(!exact);
+        CHECK(samePuzzle(&conflict, &puzzle));
+    }
+    CHECK(conflicts == 20);
+    freeRanking(ranking);
+}
+
+/**
+ * @brief Checks removeClues() against removing the clues one at a time and
+ *        counting the solutions from scratch, starting from full grids and
+ *        from puzzles that already lost some clues, and checks that no clue
+ *        it tried and kept can be removed.
+ */
+static void testRemoveClues(void)
+{
+    Ranking* rankings[2] = { createRanking(4), createRanking(6) };
+    unsigned long long random = 1618;
+
+    for (int i = 0; i < 40; i++)
+    {
+        Ranking* ranking = rankings[i % 2];
+        CHECK(ranking != NULL);
+        if (!ranking) { continue; }
+
+        Puzzle solution;
+        unrankGrid(ranking, nextRandom(&random) % countGrids(ranking), &solution);
+        int cell_count = solution.size * solution.size;
+
+        int cells[64];
+        for (int j = 0; j < cell_count; j++) { cells[j] = j; }
+        for (int j = cell_count - 1; j > 0; j--)
+        {
+            int k = nextRandom(&random) % (j + 1);
+            int cell = cells[j];
+            cells[j] = cells[k];
+            cells[k] = cell;
+        }
+
+        /* Half of the time, the first third of the clues is removed first. */
+        int skipped = i % 4 < 2 ? 0 : cell_count / 3;
+        Puzzle puzzle = skipped ? removeClues(&solution, &solution, cells, skipped) : solution;
+        Puzzle expected = puzzle;
+        for (int j = skipped; j < cell_count; j++)
+        {
+            Puzzle reduced = expected;
+            reduced.actions |= 1ULL << cells[j];
+            reduced.grid &= ~(1ULL << cells[j]);
+            if (countSolutions(reduced, 2, NULL) == 1) { expected = reduced; }
+        }
+
+        Puzzle result = removeClues(&puzzle, &solution, cells + skipped, cell_count - skipped);
+        CHECK(samePuzzle(&result, &expected));
+        CHECK(countSolutions(result, 2, NULL) == 1);
+
+        for (int j = skipped; j < cell_count; j++)
+        {
+            if (result.actions & 1ULL << cells[j]) { continue; }
+            Puzzle reduced = result;
+            reduced.actions |= 1ULL << cells[j];
+            reduced.grid &= ~(1ULL << cells[j]);
+            CHECK(countSolutions(reduced, 2, NULL) == 2);
+        }
+    }
+    for (int i = 0; i < 2; i++) { freeRanking(rankings[i]); }
+}
+
+static bool addOrbit(const Solution* solution, void* context)
+{
+    unsigned long long* total = context;
+    *total += solution->orbit;
+    return true;
+}
+
+/**
+ * @brief Checks that the orbits of the canonical solutions add up to the
+ *        number of solutions, for empty boards and boards with clues.
+ */
+static void testCanonical(void)
+{
+    unsigned long long random = 5150;
+
+    for (unsigned size = 4; size <= 6; size += 2)
+    {
+        Ranking* ranking = createRanking(size);
+        CHECK(ranking != NULL);
+        if (!ranking) { continue; }
+
+        unsigned cells = size * size;
+        for (int i = 0; i < 12; i++)
+        {
+            Puzzle grid;
+            unrankGrid(ranking, nextRandom(&random) % countGrids(ranking), &grid);
+
+            unsigned long long clues = 0;
+            while (__builtin_popcountll(clues) < (unsigned)i % 4) { clues |= 1ULL << nextRandom(&random) % cells; }
+            if (i % 4 == 3) { clues |= 1ULL << (cells - 1 - __builtin_ctzll(clues)); }
+            Puzzle puzzle = { .grid = grid.grid & clues, .actions = ~clues & ((1ULL << cells) - 1), .size = size };
+
+            unsigned long long orbits = 0;
+            unsigned long long solutions = enumerateSolutions(&puzzle, false, NULL, NULL);
+            unsigned long long canonical = enumerateSolutions(&puzzle, true, addOrbit, &orbits);
+            CHECK(orbits == solutions);
+            CHECK(canonical >= 1 && canonical <= solutions);
+            if (size == 4) { CHECK(solutions == countSolutions(puzzle, -1ULL, NULL)); }
+        }
+        freeRanking(ranking);
+    }
+}
+
+/**
+ * @brief Reads a whole file into a new buffer.
+ *
+ * @return The contents, or NULL if the file cannot be read. Must be freed.
+ */
+static char* readFile(const char* path, long* length)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) { return NULL; }
+
+    char* contents = NULL;
+    if (!fseek(file, 0, SEEK_END) && (*length = ftell(file)) >= 0 && !fseek(file, 0, SEEK_SET) &&
+        (contents = malloc(*length + 1)) && fread(contents, 1, *length, file) != (size_t)*length)
+    {
+        free(contents);
+        contents = NULL;
+    }
+    fclose(file);
+    return contents;
+}
+
+/**
+ * @brief Records the same search into ring buffers of several capacities
+ *        and checks that a buffer that wrapped around keeps exactly the
+ *        newest events of the full trace, in order.
+ */
+static void testTraceWrap(void)
+{
+    enum { CAPACITIES = 4 };
+    const size_t capacities[CAPACITIES] = { 1 << 16, 5, 13, 64 };
+    Puzzle puzzle = getPuzzle("1     0          1                  ");
+    char* files[CAPACITIES] = { NULL };
+    long lengths[CAPACITIES] = { 0 };
+
+    for (int i = 0; i < CAPACITIES; i++)
+    {
+        Trace* trace = createTrace(capacities[i]);
+        CHECK(trace != NULL);
+        if (!trace) { continue; }
+
+        CHECK(solveTraced(puzzle, trace));
+        CHECK(writeTrace(trace, TRACE_PATH));
+        files[i] = readFile(TRACE_PATH, &lengths[i]);
+        CHECK(files[i] != NULL);
+        freeTrace(trace);
+    }
+    remove(TRACE_PATH);
+
+    bool read = true;
+    for (int i = 0; i < CAPACITIES; i++) { read = read && files[i]; }
+    if (read)
+    {
+        /* All files have the same header, so its length follows from one
+         * that wrapped around. */
+        long header = lengths[1] - 5 * (long)sizeof(TraceEvent);
+        long recorded = (lengths[0] - header) / (long)sizeof(TraceEvent);
+        CHECK(recorded > 64 && recorded < 1 << 16);
+
+        for (int i = 1; i < CAPACITIES; i++)
+        {
+            long events = (long)capacities[i] * sizeof(TraceEvent);
+            CHECK(lengths[i] == header + events);
+            CHECK(!memcmp(files[i] + header, files[0] + lengths[0] - events, events));
+        }
+    }
+    for (int i = 0; i < CAPACITIES; i++) { free(files[i]); }
+}
+
+/**
+ * @brief Runs solve() on a puzzle, or prints it, with stdout going to a file.
+ *
+ * @return What was printed, or NULL if it cannot be read back. Must be freed.
+ */
+static char* captureOutput(const Puzzle* puzzle, bool solving, long* length)
+{
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int file = open(OUTPUT_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (saved < 0 || file < 0 || dup2(file, STDOUT_FILENO) < 0)
+    {
+        if (saved >= 0) { close(saved); }
+        if (file >= 0) { close(file); }
+        return NULL;
+    }
+    close(file);
+
+    if (solving) { solve(*puzzle); }
+    else { printPuzzle(puzzle); }
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    char* output = readFile(OUTPUT_PATH, length);
+    remove(OUTPUT_PATH);
+    return output;
+}
+
+/**
+ * @brief Checks that the first solution countSolutions() finds after
+ *        propagating, which the command line prints when measuring, is the
+ *        one solve() prints, also for puzzles with many solutions.
+ */
+static void testFirstSolution(void)
+{
+    Ranking* rankings[3] = { createRanking(4), createRanking(6), createRanking(8) };
+    unsigned long long random = 2718;
+    int ambiguous = 0;
+
+    for (int i = 0; i < 60; i++)
+    {
+        unsigned size = 4 + 2 * (i % 3);
+        Ranking* ranking = rankings[i % 3];
+        CHECK(ranking != NULL);
+        if (!ranking) { continue; }
+
+        Puzzle grid;
+        unrankGrid(ranking, nextRandom(&random) % countGrids(ranking), &grid);
+
+        unsigned long long board = size == 8 ? -1ULL : (1ULL << size * size) - 1;
+        unsigned long long clues = nextRandom(&random) & nextRandom(&random) & board;
+        Puzzle puzzle = { .grid = grid.grid & clues, .actions = ~clues & board, .size = size };
+
+        Puzzle root = puzzle;
+        Puzzle solution = { 0 };
+        CHECK(propagate(&root) && countSolutions(root, 1, &solution) == 1);
+        if (countSolutions(puzzle, 2, NULL) > 1) { ambiguous++; }
+
+        long solved_length = 0, printed_length = 0;
+        char* solved = captureOutput(&puzzle, true, &solved_length);
+        char* printed = captureOutput(&solution, false, &printed_length);
+        CHECK(solved && printed && solved_length == printed_length && !memcmp(solved, printed, solved_length));
+        free(solved);
+        free(printed);
+    }
+    CHECK(ambiguous > 10);
+    for (int i = 0; i < 3; i++) { freeRanking(rankings[i]); }
+}
+
+/**
+ * @brief Interrupts a shard by limiting the size of the files it may write,
+ *        resumes it and checks that the output is the same as that of a run
+ *        without interruption. A checkpoint of another shard is refused.
+ */
+static void testShardResume(void)
+{
+    Puzzle puzzles[2] = { { .grid = 0, .actions = (1ULL << 36) - 1, .size = 6 }, getPuzzle("1     0          1                  ") };
+
+    for (int i = 0; i < 2; i++)
+    {
+        Shard shard = { .prefix_rows = 2, .index = 1, .count = 2, .canonical = i == 1 };
+        long expected_length = 0;
+        long length = 0;
+
+        remove(CHECKPOINT_PATH);
+        CHECK(runShard(&puzzles[i], &shard, SHARD_PATH, CHECKPOINT_PATH) == SHARD_DONE);
+        char* expected = readFile(SHARD_PATH, &expected_length);
+        CHECK(expected != NULL && expected_length > 4096);
+        if (!expected) { continue; }
+
+        remove(CHECKPOINT_PATH);
+        struct rlimit limit;
+        getrlimit(RLIMIT_FSIZE, &limit);
+        struct rlimit lowered = { .rlim_cur = expected_length / 2, .rlim_max = limit.rlim_max };
+        void (*handler)(int) = signal(SIGXFSZ, SIG_IGN);
+        CHECK(!setrlimit(RLIMIT_FSIZE, &lowered));
+        CHECK(runShard(&puzzles[i], &shard, SHARD_PATH, CHECKPOINT_PATH) == SHARD_IO_ERROR);
+        setrlimit(RLIMIT_FSIZE, &limit);
+        signal(SIGXFSZ, handler);
+
+        Shard other = shard;
+        other.count = 3;
+        CHECK(runShard(&puzzles[i], &other, SHARD_PATH, CHECKPOINT_PATH) == SHARD_MISMATCH);
+        CHECK(runShard(&puzzles[i], &shard, SHARD_PATH, CHECKPOINT_PATH) == SHARD_DONE);
+
+        char* resumed = readFile(SHARD_PATH, &length);
+        CHECK(resumed != NULL && length == expected_length && !memcmp(resumed, expected, length));
+        free(resumed);
+        free(expected);
+    }
+    remove(SHARD_PATH);
+    remove(CHECKPOINT_PATH);
+}
+
+typedef struct
+{
+    unsigned long long count;
+    unsigned long long first_row;
+    bool matches;
+} PrefixCheck;
+
+static bool checkPrefix(const Puzzle* grid, void* context)
+{
+    PrefixCheck* check = context;
+    check->count++;
+    check->matches = check->matches && getRow(grid, 0).grid == check->first_row && isValid(grid) && !getEmpty(grid);
+    return true;
+}
+
+/**
+ * @brief Writes all 6x6 grids to a store in several runs and reads them back
+ *        by prefix.
+ */
+static void testStore(void)
+{
+    Ranking* ranking = createRanking(6);
+    CHECK(ranking != NULL);
+    if (!ranking) { return; }
+
+    unsigned long long total = countGrids(ranking);
+    unsigned long long per_row[64] = { 0 };
+    StoreWriter* writer = createStoreWriter(STORE_PATH, 6, 1000 * sizeof(unsigned long long));
+    CHECK(writer != NULL);
+    if (!writer)
+    {
+        freeRanking(ranking);
+        return;
+    }
+
+    for (unsigned long long rank = total; rank-- > 0;)
+    {
+        Puzzle grid;
+        unrankGrid(ranking, rank, &grid);
+        per_row[getRow(&grid, 0).grid]++;
+        CHECK(addToStore(writer, &grid));
+    }
+    CHECK(closeStoreWriter(writer));
+    freeRanking(ranking);
+
+    StoreReader* reader = openStore(STORE_PATH);
+    CHECK(reader != NULL);
+    if (reader)
+    {
+        CHECK(countStore(reader) == total);
+        CHECK(getStoreSize(reader) == 6);
+        CHECK(findPrefix(reader, NULL, 0, NULL, NULL) == total);
+
+        for (unsigned long long line = 0; line < 64; line++)
+        {
+            Puzzle prefix = { .grid = line, .actions = 0, .size = 6 };
+            PrefixCheck check = { .count = 0, .first_row = line, .matches = true };
+            CHECK(findPrefix(reader, &prefix, 1, checkPrefix, &check) == per_row[line]);
+            CHECK(check.count == per_row[line] && check.matches);
+        }
+        closeStore(reader);
+    }
+    remove(STORE_PATH);
+}
+
+static int compareCanonical(const void* a, const void* b)
+{
+    const Puzzle* x = a;
+    const Puzzle* y = b;
+    unsigned long long x_empty = getEmpty(x), y_empty = getEmpty(y);
+    if (x->size != y->size) { return x->size < y->size ? -1 : 1; }
+    if (x_empty != y_empty) { return x_empty < y_empty ? -1 : 1; }
+    if ((x->grid & ~x_empty) != (y->grid & ~y_empty)) { return (x->grid & ~x_empty) < (y->grid & ~y_empty) ? -1 : 1; }
+    return 0;
+}
+
+/**
+ * @brief Sorts canonical forms and drops the repeated ones.
+ *
+ * @return The number of distinct forms left at the front.
+ */
+static size_t sortDistinct(Puzzle puzzles[], size_t count)
+{
+    size_t distinct = 0;
+    qsort(puzzles, count, sizeof(Puzzle), compareCanonical);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!distinct || compareCanonical(&puzzles[distinct - 1], &puzzles[i])) { puzzles[distinct++] = puzzles[i]; }
+    }
+    return distinct;
+}
+
+/**
+ * @brief Checks that no partition file of a deduplicator is left behind,
+ *        at the first level or below it.
+ */
+static bool hasSpillFiles(void)
+{
+    const char* paths[] = { SPILL_PATH "0", SPILL_PATH "63", SPILL_PATH "0.0", SPILL_PATH "63.63" };
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++)
+    {
+        FILE* file = fopen(paths[i], "rb");
+        if (file)
+        {
+            fclose(file);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Deduplicates a stream with far more puzzles than the smallest sets
+ *        hold, so that partitions spill and split again, and checks the
+ *        output against sorting the canonical forms. The partition files
+ *        must be gone afterwards, also when the spill files cannot be
+ *        created or the output cannot be written while finishing.
+ */
+static void testDedup(void)
+{
+    enum { PUZZLES = 80000 };
+    Ranking* rankings[2] = { createRanking(4), createRanking(6) };
+    Puzzle* puzzles = malloc(PUZZLES * sizeof(Puzzle));
+    Puzzle* expected = malloc(PUZZLES * sizeof(Puzzle));
+    Puzzle* written = malloc(PUZZLES * sizeof(Puzzle));
+    unsigned long long random = 8080;
+    CHECK(rankings[0] && rankings[1] && puzzles && expected && written);
+
+    for (int i = 0; i < PUZZLES && rankings[0] && rankings[1] && puzzles && expected; i++)
+    {
+        if (i % 4 == 3)
+        {
+            puzzles[i] = transformPuzzle(&puzzles[nextRandom(&random) % i], nextRandom(&random) % SYMMETRIES);
+        }
+        else
+        {
+            Ranking* ranking = rankings[i % 16 == 0 ? 0 : 1];
+            Puzzle grid;
+            unrankGrid(ranking, nextRandom(&random) % countGrids(ranking), &grid);
+            unsigned long long board = (1ULL << grid.size * grid.size) - 1;
+            unsigned long long empty = nextRandom(&random) & board;
+            puzzles[i] = (Puzzle) { .grid = grid.grid & ~empty, .actions = empty, .size = grid.size };
+        }
+        expected[i] = getCanonical(&puzzles[i], NULL);
+    }
+    size_t unique = puzzles && expected ? sortDistinct(expected, PUZZLES) : 0;
+
+    FILE* output = fopen(OUTPUT_PATH, "w+");
+    Dedup* dedup = output && unique ? createDedup(0, SPILL_PATH, output) : NULL;
+    CHECK(dedup != NULL);
+    if (dedup)
+    {
+        DedupStats stats;
+        bool added = true;
+        for (int i = 0; i < PUZZLES; i++) { added = addToDedup(dedup, &puzzles[i]) && added; }
+        CHECK(added);
+        CHECK(finishDedup(dedup, &stats));
+        CHECK(stats.seen == PUZZLES && stats.unique == unique && stats.spilled > PUZZLES / 2);
+        CHECK(!hasSpillFiles());
+
+        char line[256];
+        size_t count = 0;
+        rewind(output);
+        while (count < PUZZLES && fgets(line, sizeof(line), output))
+        {
+            line[strcspn(line + 1, "'") + 1] = '\0';
+            Puzzle puzzle = getPuzzle(line + 1);
+            written[count++] = getCanonical(&puzzle, NULL);
+        }
+        CHECK(count == unique && sortDistinct(written, count) == unique);
+        for (size_t i = 0; i < count && count == unique; i++) { CHECK(!compareCanonical(&written[i], &expected[i])); }
+    }
+
+    /* The spill files cannot be created: adding fails once the sets fill. */
+    dedup = output ? createDedup(0, "test_takuzu.missing/spill", output) : NULL;
+    CHECK(dedup != NULL);
+    if (dedup)
+    {
+        bool added = true;
+        for (int i = 0; i < PUZZLES && added; i++) { added = addToDedup(dedup, &puzzles[i]); }
+        CHECK(!added);
+        CHECK(!finishDedup(dedup, NULL));
+    }
+
+    /* The output hits a file size limit while the partitions are finished. */
+    if (output) { output = freopen(OUTPUT_PATH, "w+", output); }
+    dedup = output ? createDedup(0, SPILL_PATH, output) : NULL;
+    CHECK(dedup != NULL);
+    if (dedup)
+    {
+        bool added = true;
+        for (int i = 0; i < PUZZLES; i++) { added = addToDedup(dedup, &puzzles[i]) && added; }
+        CHECK(added);
+        CHECK(hasSpillFiles());
+
+        struct rlimit limit;
+        getrlimit(RLIMIT_FSIZE, &limit);
+        fflush(output);
+        struct rlimit lowered = { .rlim_cur = ftell(output) + 4096, .rlim_max = limit.rlim_max };
+        void (*handler)(int) = signal(SIGXFSZ, SIG_IGN);
+        CHECK(!setrlimit(RLIMIT_FSIZE, &lowered));
+        CHECK(!finishDedup(dedup, NULL));
+        setrlimit(RLIMIT_FSIZE, &limit);
+        signal(SIGXFSZ, handler);
+        CHECK(!hasSpillFiles());
+    }
+
+    if (output) { fclose(output); }
+    remove(OUTPUT_PATH);
+    for (int i = 0; i < 2; i++) { freeRanking(rankings[i]); }
+    free(puzzles);
+    free(expected);
+    free(written);
+}
+
+/**
+ * @brief Changes some clues of a puzzle at random: each change adds,
+ *        removes or flips the clue of a random cell.
+ */
+static Puzzle perturbPuzzle(const Puzzle* puzzle, int changes, unsigned long long* random)
+{
+    Puzzle changed = *puzzle;
+    unsigned cells = changed.size * getHeight(&changed);
+    for (int i = 0; i < changes; i++)
+    {
+        unsigned long long cell = 1ULL << nextRandom(random) % cells;
+        switch (nextRandom(random) % 3)
+        {
+            case 0: changed.actions |= cell; changed.grid &= ~cell; break;
+            case 1: changed.actions &= ~cell; changed.grid &= ~cell; break;
+            default: changed.actions &= ~cell; changed.grid |= cell; break;
+        }
+    }
+    return changed;
+}
+
+static int compareNeighbours(const void* a, const void* b)
+{
+    const Neighbour* x = a;
+    const Neighbour* y = b;
+    if (x->distance != y->distance) { return x->distance < y->distance ? -1 : 1; }
+    return x->id < y->id ? -1 : x->id > y->id;
+}
+
+typedef struct
+{
+    const Puzzle* puzzles;
+    unsigned long long pairs;
+} PairCount;
+
+static bool countPair(int a, int b, int distance, void* context)
+{
+    PairCount* count = context;
+    CHECK(a < b && getDistance(&count->puzzles[a], &count->puzzles[b]) == distance);
+    count->pairs++;
+    return true;
+}
+
+/**
+ * @brief Checks the near-duplicate index against scanning every puzzle:
+ *        getDistance() against counting changed clues cell by cell, and
+ *        findWithin(), findNearest() and findNearPairs() on clusters of
+ *        similar 6x6 and 8x8 puzzles, with radii on both sides of the
+ *        switch to a linear scan.
+ */
+static void testNear(void)
+{
+    enum { PUZZLES = 1500, QUERIES = 30, K = 7 };
+    const int radii[] = { 0, 1, 2, 5, 9, 14, 24 };
+    Puzzle* puzzles = malloc(PUZZLES * sizeof(Puzzle));
+    Neighbour* results = malloc(PUZZLES * sizeof(Neighbour));
+    Neighbour* expected = malloc(PUZZLES * sizeof(Neighbour));
+    unsigned long long random = 6464;
+    CHECK(puzzles && results && expected);
+
+    for (unsigned size = 6; size <= 8 && puzzles && results && expected; size += 2)
+    {
+        unsigned cells = size * size;
+        unsigned long long board = cells < 64 ? (1ULL << cells) - 1 : -1ULL;
+        for (int i = 0; i < PUZZLES; i++)
+        {
+            if (i < 20)
+            {
+                unsigned long long empty = nextRandom(&random) & board;
+                puzzles[i] = (Puzzle) { .grid = nextRandom(&random) & ~empty, .actions = empty, .size = size };
+            }
+            else { puzzles[i] = perturbPuzzle(&puzzles[nextRandom(&random) % i], nextRandom(&random) % 5, &random); }
+        }
+
+        for (int i = 0; i < 200; i++)
+        {
+            const Puzzle* a = &puzzles[nextRandom(&random) % PUZZLES];
+            const Puzzle* b = &puzzles[nextRandom(&random) % PUZZLES];
+            int distance = 0;
+            for (unsigned cell = 0; cell < cells; cell++)
+            {
+                bool clue_a = !(getEmpty(a) >> cell & 1), clue_b = !(getEmpty(b) >> cell & 1);
+                if (clue_a != clue_b) { distance++; }
+                else if (clue_a && (a->grid >> cell & 1) != (b->grid >> cell & 1)) { distance += 2; }
+            }
+            CHECK(getDistance(a, b) == distance);
+        }
+
+        NearIndex* index = createNearIndex(puzzles, PUZZLES);
+        CHECK(index != NULL);
+        if (!index) { continue; }
+
+        for (int q = 0; q < QUERIES; q++)
+        {
+            Puzzle query = perturbPuzzle(&puzzles[nextRandom(&random) % PUZZLES], q % 4, &random);
+            for (int i = 0; i < PUZZLES; i++) { expected[i] = (Neighbour) { .id = i, .distance = getDistance(&query, &puzzles[i]) }; }
+            qsort(expected, PUZZLES, sizeof(Neighbour), compareNeighbours);
+
+            for (size_t r = 0; r < sizeof(radii) / sizeof(radii[0]); r++)
+            {
+                int within = 0;
+                while (within < PUZZLES && expected[within].distance <= radii[r]) { within++; }
+
+                int found = findWithin(index, &query, radii[r], results, PUZZLES);
+                CHECK(found == within);
+                if (found != within) { continue; }
+
+                qsort(results, found, sizeof(Neighbour), compareNeighbours);
+                for (int i = 0; i < found; i++) { CHECK(results[i].id == expected[i].id && results[i].distance == expected[i].distance); }
+            }
+
+            int nearest = findNearest(index, &query, K, results);
+            CHECK(nearest == K);
+            for (int i = 0; i < nearest; i++)
+            {
+                CHECK(results[i].distance == expected[i].distance);
+                CHECK(getDistance(&query, &puzzles[results[i].id]) == results[i].distance);
+            }
+        }
+
+        for (size_t r = 0; r < 4; r++)
+        {
+            PairCount count = { .puzzles = puzzles, .pairs = 0 };
+            unsigned long long brute = 0;
+            for (int i = 0; i < PUZZLES; i++)
+            {
+                for (int j = i + 1; j < PUZZLES; j++) { brute += getDistance(&puzzles[i], &puzzles[j]) <= radii[r]; }
+            }
+            CHECK(findNearPairs(index, radii[r], countPair, &count) == brute);
+            CHECK(count.pairs == brute);
+        }
+        freeNearIndex(index);
+    }
+    free(puzzles);
+    free(results);
+    free(expected);
+}
+
+/**
+ * @brief Writes minimal puzzles of several sizes to a catalog and reads them
+ *        back from their buckets in order.
+ */
+static void testCatalog(void)
+{
+    enum { PUZZLES = 24 };
+    Puzzle puzzles[PUZZLES];
+    int grades[PUZZLES];
+    unsigned long long random = 777;
+
+    CatalogWriter* writer = createCatalogWriter(CATALOG_PATH);
+    CHECK(writer != NULL);
+    if (!writer) { return; }
+
+    for (int i = 0; i < PUZZLES; i++)
+    {
+        unsigned size = i % 2 ? 6 : 4;
+        Ranking* ranking = createRanking(size);
+        Puzzle grid;
+        bool exact;
+
+        unrankGrid(ranking, nextRandom(&random) % countGrids(ranking), &grid);
+        puzzles[i] = findMinimalPuzzle(&grid, 2000, &exact);
+        grades[i] = addToCatalog(writer, &puzzles[i]);
+        CHECK(grades[i] >= 1 && grades[i] <= MAX_GRADE);
+        freeRanking(ranking);
+    }
+    CHECK(addToCatalog(writer, &(Puzzle) { .grid = 0, .actions = -1, .size = 4 }) == 0);
+    CHECK(closeCatalogWriter(writer));
+
+    Catalog* catalog = openCatalog(CATALOG_PATH);
+    CHECK(catalog != NULL);
+    if (catalog)
+    {
+        unsigned long long total = 0;
+        for (unsigned size = 4; size <= 8; size += 2)
+        {
+            for (int grade = 1; grade <= MAX_GRADE; grade++)
+            {
+                CatalogCursor cursor = { .size = size, .grade = grade, .next = 0 };
+                Puzzle puzzle;
+                int expected = 0;
+
+                for (int i = 0; i < PUZZLES; i++)
+                {
+                    if (puzzles[i].size != size || grades[i] != grade) { continue; }
+                    CHECK(nextInCatalog(catalog, &cursor, &puzzle));
+                    CHECK(samePuzzle(&puzzle, &puzzles[i]));
+                    expected++;
+                }
+                CHECK(!nextInCatalog(catalog, &cursor, &puzzle));
+                CHECK(countCatalog(catalog, size, grade) == (unsigned long long)expected);
+                if (expected) { CHECK(sampleCatalog(catalog, size, grade, nextRandom(&random), &puzzle)); }
+                total += expected;
+            }
+        }
+        CHECK(total == PUZZLES);
+        closeCatalog(catalog);
+    }
+
+    /* A discarded writer leaves the catalog at its path and no buckets. */
+    writer = createCatalogWriter(CATALOG_PATH);
+    CHECK(writer != NULL);
+    if (writer)
+    {
+        addToCatalog(writer, &puzzles[0]);
+        discardCatalogWriter(writer);
+    }
+    catalog = openCatalog(CATALOG_PATH);
+    CHECK(catalog != NULL);
+    if (catalog)
+    {
+        unsigned long long total = 0;
+        for (int grade = 1; grade <= MAX_GRADE; grade++) { total += countCatalog(catalog, 4, grade) + countCatalog(catalog, 6, grade); }
+        CHECK(total == PUZZLES);
+        closeCatalog(catalog);
+    }
+    FILE* bucket = fopen(CATALOG_PATH ".bucket0", "rb");
+    CHECK(bucket == NULL);
+    if (bucket) { fclose(bucket); }
+    remove(CATALOG_PATH);
+}
+
+/**
+ * @brief Checks the status and solution of every puzzle of a batch against
+ *        countSolutions(), with one thread and with several, for puzzles
+ *        of every status including rectangles and invalid dimensions.
+ */
+static void testBatch(void)
+{
+    enum { PUZZLES = 600 };
+    static unsigned long long grids[PUZZLES], actions[PUZZLES], solutions[PUZZLES];
+    static unsigned sizes[PUZZLES], heights[PUZZLES];
+    static int statuses[PUZZLES], expected[PUZZLES];
+    const unsigned shapes[][2] = { { 4, 4 }, { 6, 6 }, { 8, 8 }, { 6, 4 }, { 4, 8 }, { 5, 4 }, { 10, 8 } };
+    Ranking* rankings[2] = { createRanking(4), createRanking(6) };
+    unsigned long long random = 6502;
+    size_t solvable = 0;
+    int seen[4] = { 0 };
+
+    CHECK(rankings[0] != NULL && rankings[1] != NULL);
+    if (!rankings[0] || !rankings[1])
+    {
+        freeRanking(rankings[0]);
+        freeRanking(rankings[1]);
+        return;
+    }
+
+    for (int i = 0; i < PUZZLES; i++)
+    {
+        int shape = i % 10 < 7 ? i % 10 % 2 : (int)(nextRandom(&random) % 7);
+        unsigned size = shapes[shape][0], height = shapes[shape][1];
+        unsigned long long cells = size * height >= 64 ? -1ULL : (1ULL << size * height) - 1;
+        unsigned long long clues = nextRandom(&random) & nextRandom(&random) & cells;
+        if (i % 3 == 0) { clues |= nextRandom(&random) & cells; }
+
+        Puzzle grid = { .grid = nextRandom(&random) };
+        if (shape < 2 && i % 4) { unrankGrid(rankings[shape], nextRandom(&random) % countGrids(rankings[shape]), &grid); }
+
+        grids[i] = grid.grid & clues;
+        actions[i] = ~clues & cells;
+        sizes[i] = size;
+        heights[i] = height;
+
+        Puzzle puzzle = { .grid = grids[i], .actions = actions[i], .size = size, .height = height == size ? 0 : height };
+        Puzzle solution = { .grid = 0 };
+        solutions[i] = 0;
+        if (size % 2 || size * height > 64 || !isValid(&puzzle))
+        {
+            expected[i] = BATCH_INVALID;
+            continue;
+        }
+        unsigned long long found = countSolutions(puzzle, 2, &solution);
+        expected[i] = found == 0 ? BATCH_NO_SOLUTION : found == 1 ? BATCH_UNIQUE : BATCH_MULTIPLE;
+        solutions[i] = found ? solution.grid : 0;
+        solvable += found != 0;
+    }
+    for (int i = 0; i < PUZZLES; i++) { seen[expected[i]]++; }
+    for (int status = 0; status < 4; status++) { CHECK(seen[status] > 0); }
+
+    for (int threads = 1; threads <= 4; threads += 3)
+    {
+        unsigned long long batch_solutions[PUZZLES];
+        CHECK(solveBatch(grids, actions, sizes, heights, batch_solutions, statuses, PUZZLES, threads) == solvable);
+        for (int i = 0; i < PUZZLES; i++)
+        {
+            CHECK(statuses[i] == expected[i]);
+            CHECK(batch_solutions[i] == solutions[i]);
+        }
+    }
+
+    /* Without heights, every puzzle is square. */
+    CHECK(solveBatch(grids, actions, sizes, NULL, solutions, statuses, 2, 1) == (size_t)(expected[0] < 2) + (expected[1] < 2));
+    CHECK(statuses[0] == expected[0] && statuses[1] == expected[1]);
+
+    freeRanking(rankings[0]);
+    freeRanking(rankings[1]);
+}
+
+static int compareLatencies(const void* a, const void* b)
+{
+    unsigned long long x = *(const unsigned long long*)a, y = *(const unsigned long long*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Checks that latency percentiles never underestimate the exact
+ *        percentile of the recorded values and overestimate it by at most
+ *        the width of its bucket, for values spread over every bucket
+ *        size, on either side of powers of two and recorded by many
+ *        threads.
+ */
+static void testLatency(void)
+{
+    enum { SAMPLES = 20000 };
+    static unsigned long long values[SAMPLES];
+    const double percentiles[] = { 0, 1, 25, 50, 90, 99, 99.9, 100 };
+    unsigned long long random = 1984;
+
+    Latency* latency = createLatency();
+    CHECK(latency != NULL);
+    if (!latency) { return; }
+
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        values[i] = nextRandom(&random) >> (24 + nextRandom(&random) % 40);
+        recordLatency(latency, i % LATENCY_THREADS, 6, 6, BATCH_UNIQUE, values[i]);
+        recordLatency(latency, i % 3, 6, 4, BATCH_MULTIPLE, 1ULL << 40);
+    }
+    recordLatency(latency, 0, 5, 6, BATCH_UNIQUE, 1);
+    recordLatency(latency, LATENCY_THREADS, 6, 6, BATCH_UNIQUE, 1);
+    recordLatency(latency, 0, 6, 6, LATENCY_OUTCOMES, 1);
+    qsort(values, SAMPLES, sizeof(values[0]), compareLatencies);
+
+    CHECK(countLatency(latency, 6, 6, BATCH_UNIQUE) == SAMPLES);
+    CHECK(countLatency(latency, 6, 4, BATCH_MULTIPLE) == SAMPLES);
+    CHECK(countLatency(latency, 6, 6, BATCH_MULTIPLE) == 0);
+    CHECK(countLatency(latency, 5, 6, BATCH_UNIQUE) == 0);
+    CHECK(getLatencyPercentile(latency, 6, 6, BATCH_MULTIPLE, 50) == 0);
+    CHECK(getLatencyPercentile(latency, 6, 4, BATCH_MULTIPLE, 50) == 1ULL << 40);
+
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++)
+    {
+        unsigned long long rank = (unsigned long long)(percentiles[i] / 100 * SAMPLES + 0.5);
+        unsigned long long exact = values[rank < 1 ? 0 : rank - 1];
+        unsigned long long found = getLatencyPercentile(latency, 6, 6, BATCH_UNIQUE, percentiles[i]);
+        CHECK(found >= exact && found - exact <= exact / 32);
+    }
+    CHECK(getLatencyPercentile(latency, 6, 6, BATCH_UNIQUE, 100) == values[SAMPLES - 1]);
+    freeLatency(latency);
+
+    /* The lower of two values is reported within its own bucket. */
+    for (int exponent = 0; exponent < 40; exponent++)
+    {
+        for (int offset = -1; offset <= 1; offset++)
+        {
+            unsigned long long value = (1ULL << exponent) + offset;
+            latency = createLatency();
+            CHECK(latency != NULL);
+            if (!latency) { return; }
+
+            recordLatency(latency, 0, 4, 4, BATCH_UNIQUE, value);
+            recordLatency(latency, 1, 4, 4, BATCH_UNIQUE, 1ULL << 41);
+            unsigned long long found = getLatencyPercentile(latency, 4, 4, BATCH_UNIQUE, 50);
+            CHECK(found >= value && found - value <= value / 32);
+            CHECK(getLatencyPercentile(latency, 4, 4, BATCH_UNIQUE, 100) == 1ULL << 41);
+            freeLatency(latency);
+        }
+    }
+}
+
+int main(void)
+{
+    testKernels();
+    testDrawBelow();
+    if (STANDARD_RULES)
+    {
+        testEmptyCounts();
+        testRanking();
+        testWithoutClues();
+        testRectangles();
+        testEdges();
+        testAssumptions();
+        testConflict();
+        testRemoveClues();
+        testCanonical();
+        testShardResume();
+        testTraceWrap();
+        testFirstSolution();
+        testStore();
+        testDedup();
+        testNear();
+        testCatalog();
+        testBatch();
+        testLatency();
+    }
+
+    if (failures)
+    {
+        printf("%d checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All checks passed.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "trace.h"
+
+#define TRACE_MAGIC 0x52544B54U
+
+
+/**
+ * A trace file is a header followed by the events that were still in the
+ * ring buffer, oldest first. Events are fixed size: the low 32 bits of the
+ * node count, the depth, the cell and the kind, plus the value of the cell,
+ * which for TRACE_REJECT also holds the reason as reason << 1 | value.
+ */
+typedef struct
+{
+    unsigned magic;
+    unsigned size;
+    unsigned height;
+    unsigned event_size;
+    unsigned long long id;
+    unsigned long long recorded;
+    unsigned long long stored;
+} TraceHeader;
+
+struct Trace
+{
+    TraceEvent* events;
+    size_t capacity;
+    unsigned long long recorded;
+    unsigned long long id;
+    unsigned size;
+    unsigned height;
+};
+
+static const char* reason_names[] = { "unknown", "edge marker", "unbalanced", "run too long", "duplicate line" };
+
+/**
+ * @brief Creates a trace recorder for solveTraced().
+ *
+ * The buffer is allocated once; when it is full, new events overwrite the
+ * oldest ones, so recording takes the same memory and time per event no
+ * matter how long the search runs.
+ *
+ * @param capacity The number of events kept.
+ *
+ * @return The recorder, or NULL if capacity is 0 or out of memory.
+ */
+Trace* createTrace(size_t capacity)
+{
+    if (!capacity) { return NULL; }
+
+    Trace* trace = calloc(1, sizeof(Trace));
+    if (!trace) { return NULL; }
+
+    trace->events = malloc(capacity * sizeof(TraceEvent));
+    if (!trace->events)
+    {
+        free(trace);
+        return NULL;
+    }
+    trace->capacity = capacity;
+    return trace;
+}
+
+void freeTrace(Trace* trace)
+{
+    if (!trace) { return; }
+    free(trace->events);
+    free(trace);
+}
+
+/**
+ * @brief Empties the recorder and notes the puzzle about to be searched.
+ */
+void startTrace(Trace* trace, const Puzzle* puzzle)
+{
+    trace->recorded = 0;
+    trace->id = getPuzzleId(puzzle);
+    trace->size = puzzle->size;
+    trace->height = getHeight(puzzle);
+}
+
+/**
+ * @brief Appends an event to the ring buffer, overwriting the oldest if it
+ *        is full.
+ *
+ * @param trace The recorder.
+ * @param kind What happened.
+ * @param node The number of search nodes visited so far.
+ * @param depth The depth of the node the event happened in.
+ * @param cell The cell assigned or rejected, 0 otherwise.
+ * @param value The value of the cell, see TraceHeader for TRACE_REJECT.
+ */
+void recordTrace(Trace* trace, TraceKind kind, unsigned long long node, int depth, int cell, int value)
+{
+    TraceEvent* event = &trace->events[trace->recorded++ % trace->capacity];
+    event->node = (unsigned)node;
+    event->depth = (unsigned char)depth;
+    event->cell = (unsigned char)cell;
+    event->kind = (unsigned char)kind;
+    event->value = (unsigned char)value;
+}
+
+/**
+ * @brief Finds out which rule a value that isValid() turned down breaks.
+ *
+ * The puzzle was valid before the cell was filled in, so only the markers,
+ * and the row and the column of the cell have to be checked. If those are
+ * balanced and free of long runs, the line duplicates another one.
+ *
+ * @param puzzle The rejected puzzle.
+ * @param cell The cell that was just filled in.
+ *
+ * @return The rule that is broken.
+ */
+TraceReason getRejection(const Puzzle* puzzle, int cell)
+{
+    if (!meetsEdges(puzzle)) { return REASON_EDGE; }
+
+    Puzzle row = getRow(puzzle, cell / puzzle->size);
+    Puzzle col = getCol(puzzle, cell % puzzle->size);
+    if (!isBalanced(&row) || !isBalanced(&col)) { return REASON_BALANCE; }
+    if (hasTriplets(&row) || hasTriplets(&col)) { return REASON_RUN; }
+    return RULE_UNIQUE ? REASON_DUPLICATE : REASON_NONE;
+}
+
+/**
+ * @brief Writes the events in the ring buffer to a file, oldest first.
+ *
+ * @return true on success, false if the file cannot be written.
+ */
+bool writeTrace(const Trace* trace, const char* path)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file) { return false; }
+
+    unsigned long long stored = trace->recorded < trace->capacity ? trace->recorded : trace->capacity;
+    TraceHeader header = {
+        .magic = TRACE_MAGIC,
+        .size = trace->size,
+        .height = trace->height,
+        .event_size = sizeof(TraceEvent),
+        .id = trace->id,
+        .recorded = trace->recorded,
+        .stored = stored
+    };
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    size_t first = (trace->recorded - stored) % trace->capacity;
+    size_t tail = stored < trace->capacity - first ? stored : trace->capacity - first;
+    written = written && fwrite(&trace->events[first], sizeof(TraceEvent), tail, file) == tail;
+    written = written && fwrite(trace->events, sizeof(TraceEvent), stored - tail, file) == stored - tail;
+    return fclose(file) == 0 && written;
+}
+
+/**
+ * @brief Prints one event of a trace as a line of the tree.
+ *
+ * Each line is indented by its depth. A rejection is printed on the line of
+ * the assignment it turned down, so the children of an assignment are the
+ * lines below it that are indented further.
+ *
+ * @param event The event to be printed.
+ * @param next The event after it, or NULL.
+ * @param size The width of the grid.
+ * @param indent The depth of the shallowest event in the trace.
+ * @param output Where the line is printed.
+ *
+ * @return The number of events printed, 2 if next was a rejection.
+ */
+static int printEvent(const TraceEvent* event, const TraceEvent* next, unsigned size, int indent, FILE* output)
+{
+    fprintf(output, "%*s", 2 * (event->depth - indent), "");
+    switch (event->kind)
+    {
+        case TRACE_ASSIGN:
+            fprintf(output, "r%dc%d = %d", event->cell / size, event->cell % size, event->value);
+            if (next && next->kind == TRACE_REJECT && next->cell == event->cell && next->depth == event->depth)
+            {
+                int reason = next->value >> 1;
+                fprintf(output, " rejected: %s\n", reason_names[reason <= REASON_DUPLICATE ? reason : 0]);
+                return 2;
+            }
+            fprintf(output, " (node %u)\n", event->node);
+            return 1;
+        case TRACE_REJECT:
+            fprintf(output, "r%dc%d = %d rejected\n", event->cell / size, event->cell % size, event->value & 1);
+            return 1;
+        case TRACE_BACKTRACK:
+            fprintf(output, "backtrack (node %u)\n", event->node);
+            return 1;
+        case TRACE_SOLVED:
+            fprintf(output, "solved (node %u)\n", event->node);
+            return 1;
+    }
+    fprintf(output, "unknown event %d\n", event->kind);
+    return 1;
+}
+
+/**
+ * @brief Prints a trace file written by writeTrace() as an indented tree.
+ *
+ * If the ring buffer overflowed, the tree starts at the oldest event that
+ * was kept and is indented relative to the shallowest depth among them.
+ *
+ * @param path The trace file.
+ * @param output Where the tree is printed.
+ *
+ * @return true on success, false if the file cannot be read or is not a
+ *         trace.
+ */
+bool printTraceTree(const char* path, FILE* output)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) { return false; }
+
+    TraceHeader header;
+    TraceEvent* events = NULL;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+        header.magic == TRACE_MAGIC && header.event_size == sizeof(TraceEvent) &&
+        header.size && header.stored <= header.recorded &&
+        (events = malloc((header.stored ? header.stored : 1) * sizeof(TraceEvent))) &&
+        fread(events, sizeof(TraceEvent), header.stored, file) == header.stored;
+    fclose(file);
+    if (!valid)
+    {
+        free(events);
+        return false;
+    }
+
+    fprintf(output, "Trace of puzzle %016llx (%ux%u): %llu events, %llu dropped\n",
+        header.id, header.size, header.height, header.recorded, header.recorded - header.stored);
+
+    int indent = 255;
+    for (unsigned long long i = 0; i < header.stored; i++)
+    {
+        if (events[i].depth < indent) { indent = events[i].depth; }
+    }
+
+    for (unsigned long long i = 0; i < header.stored;)
+    {
+        i += printEvent(&events[i], i + 1 < header.stored ? &events[i + 1] : NULL, header.size, indent, output);
+    }
+
+    free(events);
+    return true;
+}
@@ -0,0 +1,43 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include "takuzu.h"
+
+#define TRACE_EVENTS 65536
+
+typedef enum
+{
+    TRACE_ASSIGN,
+    TRACE_REJECT,
+    TRACE_BACKTRACK,
+    TRACE_SOLVED
+} TraceKind;
+
+typedef enum
+{
+    REASON_NONE,
+    REASON_EDGE,
+    REASON_BALANCE,
+    REASON_RUN,
+    REASON_DUPLICATE
+} TraceReason;
+
+typedef struct
+{
+    unsigned node;
+    unsigned char depth;
+    unsigned char cell;
+    unsigned char kind;
+    unsigned char value;
+} TraceEvent;
+
+Trace* createTrace(size_t capacity);
+void freeTrace(Trace* trace);
+void startTrace(Trace* trace, const Puzzle* puzzle);
+void recordTrace(Trace* trace, TraceKind kind, unsigned long long node, int depth, int cell, int value);
+TraceReason getRejection(const Puzzle* puzzle, int cell);
+bool writeTrace(const Trace* trace, const char* path);
+bool printTraceTree(const char* path, FILE* output);
+
+#endif